@@ -0,0 +1,304 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Generator for synthetic MediaWiki page, pagelinks and redirect table
+ * dumps, for benchmarking wikiassoc without downloading a real Wikipedia.
+ *
+ * Pages are spread over several namespaces; titles contain characters that
+ * need SQL escaping. Out-degrees follow a Pareto distribution and link
+ * targets are drawn with a bias towards low page numbers, so in-degrees
+ * follow a power law with a few very popular hubs. Output only depends on
+ * the number of pages and the seed.
+ */
+
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    // Rows per INSERT statement, as in the Wikimedia dumps
+    const unsigned ROWS_PER_INSERT = 1000;
+
+    const unsigned MAX_OUT_DEGREE = 2000;
+
+    void usage(char const *progname)
+    {
+        std::cerr << "usage: " << progname << " [-s SEED] npages outdir\n"
+                  << "    -s SEED  random seed, default 1\n"
+                  << "Writes outdir/page.sql, outdir/pagelinks.sql and"
+                     " outdir/redirect.sql\n";
+        std::exit(1);
+    }
+
+    /*
+     * xorshift64* generator; we don't want output to depend on the
+     * C library's rand().
+     */
+    class Random {
+        unsigned long long state;
+
+      public:
+        explicit Random(unsigned long long seed)
+          : state(seed * 0x9E3779B97F4A7C15ULL + 1) { }
+
+        unsigned long long next()
+        {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return state * 2685821657736338717ULL;
+        }
+
+        // Uniform in [0,1)
+        double uniform() { return (next() >> 11) * (1. / 9007199254740992.); }
+    };
+
+    // Stateless hash, used so that per-page properties can be recomputed
+    // from the page number when writing the link table.
+    unsigned long long mix(unsigned long long x)
+    {
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDULL;
+        x ^= x >> 33;
+        x *= 0xC4CEB9FE1A85EC53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    /*
+     * Namespace of page i: mostly articles, plus talk, user, project
+     * and category pages.
+     */
+    unsigned page_ns(unsigned i)
+    {
+        unsigned r = mix(i) % 100;
+        return r < 70 ? 0
+             : r < 80 ? 1
+             : r < 85 ? 2
+             : r < 90 ? 4
+             : 14;
+    }
+
+    // 15% of articles are redirects, except for page 0
+    bool is_redirect(unsigned i)
+    {
+        return i > 0 && page_ns(i) == 0 && mix(i ^ 0xABCDEF) % 100 < 15;
+    }
+
+    /*
+     * Unique title for page i, SQL-escaped. The syllable encoding of i
+     * makes titles unique; some get an apostrophe, a backslash, quotes
+     * or a disambiguating suffix.
+     */
+    std::string title(unsigned i)
+    {
+        static char const *const syllables[] = {
+            "ka", "lo", "mi", "ra", "ne", "tu", "si", "va",
+            "do", "re", "fa", "po", "li", "an", "ge", "zu"
+        };
+
+        std::string t;
+        unsigned long long h = mix(i + 0x1234567ULL);
+        switch (h % 32) {
+          case 0:   t = "O\\'";             break;
+          case 1:   t = "\\\"Al\\\"_";      break;
+          case 2:   t = "Back\\\\slash_";   break;
+        }
+
+        std::string word;
+        unsigned x = i;
+        do {
+            word += syllables[x % 16];
+            x /= 16;
+        } while (x);
+        word[0] = std::toupper(word[0]);
+        t += word;
+
+        switch ((h >> 8) % 16) {
+          case 0:   t += "_(film)";         break;
+          case 1:   t += "_(disambiguation)"; break;
+          case 2:   t += "\\'s_theorem";    break;
+        }
+        return t;
+    }
+
+    /*
+     * Draw a link target with power-law popularity: low page numbers
+     * are hubs. Targets beyond npages are red links.
+     */
+    unsigned link_target(Random &rnd, unsigned npages)
+    {
+        double u = rnd.uniform();
+        return unsigned(npages * 1.05 * u * u * u);
+    }
+
+    unsigned out_degree(Random &rnd)
+    {
+        // Pareto with minimum 4 and shape 1.3; mean approx. 17
+        double d = 4. * std::pow(1. - rnd.uniform(), -1. / 1.3);
+        return std::min(unsigned(d), MAX_OUT_DEGREE);
+    }
+
+    // Target of redirect page i: some earlier non-redirect article
+    unsigned redirect_target(unsigned i)
+    {
+        unsigned long long h = mix(i ^ 0x5555);
+        for (unsigned tries = 0; tries < 64; tries++) {
+            unsigned j = (h >> 16) % i;
+            if (page_ns(j) == 0 && !is_redirect(j))
+                return j;
+            h = mix(h);
+        }
+        return 0;
+    }
+
+    /*
+     * Helper for writing multi-row INSERT statements.
+     */
+    class InsertWriter {
+        std::ostream &out;
+        char const *table;
+        unsigned nrows;
+
+      public:
+        InsertWriter(std::ostream &o, char const *t)
+          : out(o), table(t), nrows(0)
+        {
+            out << "-- Synthetic MediaWiki dump generated by gendump\n"
+                << "/*!40101 SET NAMES utf8 */;\n"
+                << "DROP TABLE IF EXISTS `" << table << "`;\n";
+        }
+
+        ~InsertWriter()
+        {
+            if (nrows % ROWS_PER_INSERT)
+                out << ";\n";
+        }
+
+        // Start a new row; returns the stream to write its fields to.
+        // Must be followed by end_row() once the row is written.
+        std::ostream &row()
+        {
+            if (nrows % ROWS_PER_INSERT == 0)
+                out << "INSERT INTO `" << table << "` VALUES ";
+            else
+                out << ',';
+            nrows++;
+            return out;
+        }
+
+        void end_row()
+        {
+            if (nrows % ROWS_PER_INSERT == 0)
+                out << ";\n";
+        }
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long long seed = 1;
+
+    for (int opt; (opt = getopt(argc, argv, "s:")) != -1; ) {
+        switch (opt) {
+          case 's':
+            try {
+                seed = boost::lexical_cast<unsigned long long>(optarg);
+            } catch (boost::bad_lexical_cast const &e) {
+                usage(argv[0]);
+            }
+            break;
+          default:
+            usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2)
+        usage(argv[0]);
+
+    unsigned npages;
+    try {
+        npages = boost::lexical_cast<unsigned>(argv[optind]);
+    } catch (boost::bad_lexical_cast const &e) {
+        usage(argv[0]);
+    }
+    std::string outdir(argv[optind + 1]);
+
+    std::ofstream pagefile((outdir + "/page.sql").c_str()),
+                  linkfile((outdir + "/pagelinks.sql").c_str()),
+                  redirfile((outdir + "/redirect.sql").c_str());
+    if (!pagefile || !linkfile || !redirfile) {
+        std::cerr << argv[0] << ": cannot write to " << outdir << std::endl;
+        return 1;
+    }
+
+    Random rnd(seed);
+
+    {
+        InsertWriter pages(pagefile, "page"), redirects(redirfile, "redirect");
+
+        for (unsigned i = 0; i < npages; i++) {
+            bool redirect = is_redirect(i);
+
+            // page_id, page_namespace, page_title, page_restrictions,
+            // page_counter, page_is_redirect, page_is_new, page_random,
+            // page_touched, page_latest, page_len
+            pages.row() << '(' << i + 1 << ',' << page_ns(i) << ",'"
+                        << title(i) << "','',0," << redirect << ",0,"
+                        << rnd.uniform() << ",'20110101000000',"
+                        << i + 1 << ',' << 100 + mix(i) % 50000 << ')';
+            pages.end_row();
+
+            if (redirect) {
+                redirects.row() << '(' << i + 1 << ",0,'"
+                                << title(redirect_target(i)) << "','','')";
+                redirects.end_row();
+            }
+        }
+    }
+
+    {
+        InsertWriter links(linkfile, "pagelinks");
+        std::vector<unsigned> targets;
+
+        for (unsigned i = 0; i < npages; i++) {
+            targets.clear();
+            if (is_redirect(i))
+                targets.push_back(redirect_target(i));
+            else
+                for (unsigned d = out_degree(rnd); d > 0; d--)
+                    targets.push_back(link_target(rnd, npages));
+
+            // (pl_from, pl_namespace, pl_title) is unique
+            std::sort(targets.begin(), targets.end());
+            targets.erase(std::unique(targets.begin(), targets.end()),
+                          targets.end());
+
+            for (std::size_t t = 0; t < targets.size(); t++) {
+                unsigned j = targets[t];
+                links.row() << '(' << i + 1 << ',' << page_ns(j) << ",'"
+                            << title(j) << "')";
+                links.end_row();
+            }
+        }
+    }
+
+    if (!pagefile || !linkfile || !redirfile) {
+        std::cerr << argv[0] << ": error writing to " << outdir << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# End-to-end benchmark for wikiassoc on synthetic dumps.
+#
+# usage: run-bench.sh gendump wikiassoc "SIZES" "THREADS" "LAYOUTS"
+#                     [wikiassoc flags]
+#
+# For each size (number of pages) a dump is generated once, then wikiassoc
+# is run for each thread count and matrix layout (hash, or compressed for
+# -z) with --stats. Results are written to stdout as tab-separated lines
+#
+#   pages requested_threads threads layout phase wall_seconds cpu_seconds
+#   peak_rss_bytes
+#
+# where threads is the number the execution plan used, from the stats,
+# preceded by comment lines describing the build, so that runs on
+# different commits can be compared with diff or any spreadsheet.
+
+set -e
+
+gendump=$1
+wikiassoc=$2
+sizes=$3
+threads=$4
+layouts=$5
+shift 5
+
+workdir=${TMPDIR:-/tmp}/wikiassoc-bench.$$
+mkdir -p "$workdir"
+trap 'rm -rf "$workdir"' EXIT INT TERM
+
+echo "# wikiassoc benchmark"
+echo "# commit: $(git describe --always --dirty 2>/dev/null || echo unknown)"
+echo "# host: $(uname -srm), $(getconf _NPROCESSORS_ONLN 2>/dev/null || echo '?') cpus"
+echo "# flags: $*"
+printf '# pages\trequested_threads\tthreads\tlayout\tphase'
+printf '\twall_seconds\tcpu_seconds\tpeak_rss_bytes\n'
+
+for n in $sizes; do
+    "$gendump" "$n" "$workdir"
+    for t in $threads; do
+        for l in $layouts; do
+            case $l in
+              hash)       layout_flag= ;;
+              compressed) layout_flag=-z ;;
+              *)          echo "unknown layout $l" >&2; exit 1 ;;
+            esac
+            OMP_NUM_THREADS=$t "$wikiassoc" -q --stats "$workdir/stats.json" \
+                $layout_flag "$@" \
+                "$workdir/page.sql" "$workdir/pagelinks.sql" > /dev/null
+            # --stats writes one field per line; pick out the ones we
+            # report, and the threads used from the plan phase
+            used=$(awk '
+                /"name":/    { gsub(/[",]/, "", $2); name = $2 }
+                /"threads":/ { gsub(/,/, "", $2)
+                               if (name == "plan") { print $2; exit } }
+            ' "$workdir/stats.json")
+            awk -v n="$n" -v t="$t" -v u="${used:-?}" -v l="$l" '
+                /"name":/           { gsub(/[",]/, "", $2); name = $2 }
+                /"wall_seconds":/   { gsub(/,/, "", $2); wall = $2 }
+                /"cpu_seconds":/    { gsub(/,/, "", $2); cpu = $2 }
+                /"peak_rss_bytes":/ { gsub(/,/, "", $2); rss = $2
+                                      printf "%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n",
+                                             n, t, u, l, name, wall, cpu,
+                                             rss }
+            ' "$workdir/stats.json"
+        done
+    done
+done
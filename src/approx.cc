@@ -0,0 +1,120 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "wikiassoc.hpp"
+
+#include "matrix.hpp"
+
+namespace {
+    typedef std::vector<std::pair<unsigned, Real> > Row;
+
+    bool GtBySecond(std::pair<unsigned, Real> const &x,
+                    std::pair<unsigned, Real> const &y)
+    {
+        return x.second > y.second;
+    }
+
+    bool LtByFirst(std::pair<unsigned, Real> const &x,
+                   std::pair<unsigned, Real> const &y)
+    {
+        return x.first < y.first;
+    }
+
+    /*
+     * Fraction of the top k of approx that belongs in the top k of exact.
+     * Elements tied with the k'th exact score count as correct.
+     * Sorts both rows.
+     */
+    double recall(Row &exact, Row &approx, std::size_t k)
+    {
+        std::size_t ke = std::min(k, exact.size()),
+                    ka = std::min(k, approx.size());
+        if (ke == 0)
+            return 1.;
+
+        std::nth_element(exact.begin(), exact.begin() + ke - 1, exact.end(),
+                         GtBySecond);
+        Real kth = exact[ke - 1].second;
+        std::partial_sort(approx.begin(), approx.begin() + ka, approx.end(),
+                          GtBySecond);
+        std::sort(exact.begin(), exact.end(), LtByFirst);
+
+        std::size_t correct = 0;
+        for (std::size_t j = 0; j < ka; j++) {
+            Row::iterator e = std::lower_bound(exact.begin(), exact.end(),
+                                               approx[j], LtByFirst);
+            if (e != exact.end() && e->first == approx[j].first
+             && e->second >= kth)
+                correct++;
+        }
+        return double(correct) / ke;
+    }
+}
+
+/**
+ * Estimate recall@k of an approximate pf-ibf computation c * d + c against
+ * the exact a * b + a, averaged over a uniform sample of sample_size
+ * non-empty rows. c and d are either a and a pruned copy of it (b == a),
+ * or copies of a and b stored at lower precision.
+ */
+template <typename W, typename V>
+double sample_recall(BasicMatrix<W> const &a, BasicMatrix<W> const &b,
+                     BasicMatrix<V> const &c, BasicMatrix<V> const &d,
+                     std::size_t k, unsigned sample_size)
+{
+    if (a.nrows() == 0 || k == 0)
+        return 1.;
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<unsigned> pick(0, a.nrows() - 1);
+
+    std::vector<unsigned> sample;
+    for (unsigned tries = 0; sample.size() < sample_size
+                          && tries < 10 * sample_size; tries++) {
+        unsigned i = pick(rng);
+        if (a.row_size(i) > 0)
+            sample.push_back(i);
+    }
+    if (sample.empty())
+        return 1.;
+
+    double total = 0;
+    int s, ns = sample.size();
+
+    #pragma omp parallel for reduction(+:total) schedule(dynamic)
+    for (s=0; s<ns; s++) {
+        Row exact, approx;
+        a.product_row(b, sample[s], exact);
+        c.product_row(d, sample[s], approx);
+        total += recall(exact, approx, k);
+    }
+    return total / ns;
+}
+
+#define INSTANTIATE(W) \
+    template double sample_recall(BasicMatrix<W> const &, \
+                                  BasicMatrix<W> const &, \
+                                  BasicMatrix<W> const &, \
+                                  BasicMatrix<W> const &, \
+                                  std::size_t, unsigned);
+FOR_EACH_WEIGHT(INSTANTIATE)
+#undef INSTANTIATE
+
+#define INSTANTIATE(W) \
+    template double sample_recall(Matrix const &, Matrix const &, \
+                                  BasicMatrix<W> const &, \
+                                  BasicMatrix<W> const &, \
+                                  std::size_t, unsigned);
+FOR_EACH_OTHER_WEIGHT(INSTANTIATE)
+#undef INSTANTIATE
@@ -14,6 +14,7 @@
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/random_access_index.hpp>
+#include <climits>
 #include <string>
 
 /**
@@ -52,4 +53,43 @@ class ArticleSet : public boost::multi_index_container<
 {
 };
 
+/**
+ * Redirect page. Only the title and database id are known after reading
+ * the page table; the target title and its index in the ArticleSet are
+ * filled in by parse_redirecttable.
+ */
+struct Redirect
+{
+    std::string title;
+    unsigned db_id;
+
+    // Not part of any index key, so these may be set in place
+    mutable std::string target;
+    mutable unsigned target_idx;    // UINT_MAX if unresolved
+
+    Redirect(std::string const &t, unsigned id)
+      : title(t), db_id(id), target_idx(UINT_MAX) { }
+};
+
+/**
+ * Collection of redirect pages, indexed by title and by MediaWiki
+ * database id
+ */
+class RedirectSet : public boost::multi_index_container<
+    Redirect,
+    boost::multi_index::indexed_by<
+        boost::multi_index::hashed_unique<
+            boost::multi_index::tag<by_db_id>,
+            boost::multi_index::member<Redirect, unsigned, &Redirect::db_id>
+        >,
+        boost::multi_index::hashed_unique<
+            boost::multi_index::tag<by_title>,
+            boost::multi_index::member<Redirect, std::string,
+                                       &Redirect::title>
+        >
+    >
+>
+{
+};
+
 #endif  // ARTICLE_HPP
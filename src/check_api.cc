@@ -0,0 +1,365 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Checks of the library interface, run by "make check": building graphs,
+ * snapshots, planning and running.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "libwikiassoc.hpp"
+
+using wikiassoc::Association;
+using wikiassoc::Graph;
+using wikiassoc::Options;
+
+namespace {
+    int failures = 0;
+
+    #define CHECK(cond) check((cond), #cond, __LINE__)
+
+    void check(bool ok, char const *what, int line)
+    {
+        if (!ok) {
+            std::cerr << "check_api:" << line << ": failed: " << what
+                      << '\n';
+            failures++;
+        }
+    }
+
+    // Whether calling f throws an exception of type E
+    template <typename E, typename F>
+    bool throws(F f)
+    {
+        try {
+            f();
+        } catch (E const &) {
+            return true;
+        } catch (...) {
+        }
+        return false;
+    }
+
+    typedef std::map<unsigned, std::vector<Association> > Results;
+
+    Results run(Graph &g, Options const &opt)
+    {
+        Results res;
+        std::mutex lock;
+        g.run(opt, [&](unsigned i, std::vector<Association> const &rel) {
+            std::lock_guard<std::mutex> guard(lock);
+            res[i] = rel;
+        });
+        return res;
+    }
+
+    // Same articles and scores, up to rounding
+    bool same(Results const &x, Results const &y)
+    {
+        if (x.size() != y.size())
+            return false;
+        for (Results::const_iterator i = x.begin(), j = y.begin();
+             i != x.end(); ++i, ++j) {
+            if (i->first != j->first || i->second.size() != j->second.size())
+                return false;
+            for (std::size_t t = 0; t < i->second.size(); t++)
+                if (std::fabs(i->second[t].second - j->second[t].second)
+                    > 1e-5 * i->second[t].second)
+                    return false;
+        }
+        return true;
+    }
+
+    std::vector<std::string> const TITLES = { "Ka", "Lo", "Mi", "Ra", "Ne" };
+
+    std::vector<std::pair<unsigned, unsigned> > const LINKS = {
+        { 0, 1 }, { 0, 2 }, { 1, 2 }, { 2, 3 }, { 3, 0 }, { 3, 4 },
+        { 4, 1 }, { 4, 2 }, { 0, 1 }
+    };
+
+    void check_assign()
+    {
+        Graph g;
+        g.assign(TITLES, LINKS);
+        CHECK(g.size() == 5);
+        CHECK(g.nlinks() == 8);         // (0,1) is repeated
+        CHECK(g.title(3) == "Ra");
+
+        std::vector<std::string> dup = { "Ka", "Lo", "Ka" };
+        CHECK(throws<std::invalid_argument>([&] { g.assign(dup, LINKS); }));
+        std::vector<std::pair<unsigned, unsigned> > out = { { 0, 5 } };
+        CHECK(throws<std::out_of_range>([&] { g.assign(TITLES, out); }));
+    }
+
+    void check_run()
+    {
+        Graph g;
+        g.assign(TITLES, LINKS);
+        Results res = run(g, Options());
+        CHECK(!res.empty());
+        for (Results::const_iterator r = res.begin(); r != res.end(); ++r) {
+            CHECK(r->first < g.size());
+            for (std::size_t t = 0; t < r->second.size(); t++) {
+                CHECK(r->second[t].first != r->first);
+                CHECK(t == 0 || r->second[t].second <= r->second[t-1].second);
+            }
+        }
+        CHECK(throws<std::logic_error>([&] { run(g, Options()); }));
+    }
+
+    // Running leaves the caller's thread count alone, and a run that
+    // fails before using the graph can be retried
+    void check_retry()
+    {
+        #ifdef _OPENMP
+            omp_set_num_threads(3);
+        #endif
+        Graph g;
+        g.assign(TITLES, LINKS);
+        Options opt;
+        opt.memory_budget = 1;
+        opt.numa = true;
+        CHECK(throws<std::runtime_error>([&] { run(g, opt); }));
+        opt.memory_budget = 0;
+        CHECK(!run(g, opt).empty());
+        #ifdef _OPENMP
+            CHECK(omp_get_max_threads() == 3);
+        #endif
+    }
+
+    // Planning doesn't consume the graph, for any storage type
+    void check_plan()
+    {
+        char const *types[] = { "float", "double", "bf16" };
+        for (std::size_t t = 0; t < 3; t++) {
+            Graph g;
+            g.assign(TITLES, LINKS);
+            Options opt;
+            opt.precision = types[t];
+            opt.compress = true;
+
+            std::ostringstream plan;
+            CHECK(g.plan(opt, plan));
+            CHECK(plan.str().find("strategy:") != std::string::npos);
+            CHECK(g.nlinks() == 8);
+            CHECK(!run(g, opt).empty());
+        }
+
+        Graph g;
+        g.assign(TITLES, LINKS);
+        Options opt;
+        opt.precision = "bf16";
+        std::ostringstream plan;
+        CHECK(throws<std::invalid_argument>([&] { g.plan(opt, plan); }));
+    }
+
+    // No article is associated with itself, even if it links to itself,
+    // and -t gives the same result as the full product
+    void check_self_links()
+    {
+        std::vector<std::pair<unsigned, unsigned> > links(LINKS);
+        links.push_back(std::make_pair(1, 1));
+        links.push_back(std::make_pair(2, 2));
+
+        Results full;
+        for (int mode = 0; mode < 4; mode++) {
+            Graph g;
+            g.assign(TITLES, links);
+            Options opt;
+            opt.topk = mode == 1;
+            opt.compress = mode == 2;
+            opt.path_length = mode == 3 ? 3 : 2;
+
+            Results res = run(g, opt);
+            for (Results::const_iterator r = res.begin(); r != res.end();
+                 ++r)
+                for (std::size_t t = 0; t < r->second.size(); t++)
+                    CHECK(r->second[t].first != r->first);
+            if (mode == 0)
+                full = res;
+            else if (mode == 1)
+                CHECK(same(full, res));
+        }
+    }
+
+    // An empty graph gives no results, whatever the options
+    void check_empty()
+    {
+        for (int mode = 0; mode < 5; mode++) {
+            Graph g;
+            g.assign(std::vector<std::string>(),
+                     std::vector<std::pair<unsigned, unsigned> >());
+            Options opt;
+            opt.fanout = mode == 1 ? 10 : 0;
+            opt.hub_threshold = mode == 2 ? 1 : 0;
+            opt.precision = mode == 3 ? "double" : "float";
+            opt.topk = mode == 4;
+            CHECK(run(g, opt).empty());
+        }
+    }
+
+    void check_read_dumps()
+    {
+        std::istringstream pages(
+            "INSERT INTO `page` VALUES "
+            "(1,0,'Ka','',0,0,0,0.5,'20110101000000',1,100),"
+            "(2,0,'Lo','',0,0,0,0.5,'20110101000000',2,100),"
+            "(3,1,'Talk','',0,0,0,0.5,'20110101000000',3,100),"
+            "(4,0,'O\\'Mi','',0,0,0,0.5,'20110101000000',4,100);\n");
+        std::istringstream links(
+            "INSERT INTO `pagelinks` VALUES "
+            "(1,0,'Lo'),(1,0,'O\\'Mi'),(2,0,'Ka'),(4,0,'Ka'),"
+            "(4,0,'Nowhere'),(4,1,'Ka');\n");
+
+        Graph g;
+        g.read_dumps(pages, links);
+        CHECK(g.size() == 3);           // main namespace only
+        CHECK(g.nlinks() == 4);
+        bool quoted = false;
+        for (unsigned i = 0; i < g.size(); i++)
+            quoted = quoted || g.title(i) == "O'Mi";
+        CHECK(quoted);
+    }
+
+    // Current page tables lack page_restrictions and page_counter; the
+    // position of page_is_redirect is taken from CREATE TABLE
+    void check_page_columns()
+    {
+        std::string const create =
+            "CREATE TABLE `page` (\n"
+            "  `page_id` int(10) unsigned NOT NULL AUTO_INCREMENT,\n"
+            "  `page_namespace` int(11) NOT NULL DEFAULT '0',\n"
+            "  `page_title` varbinary(255) NOT NULL DEFAULT '',\n"
+            "  `page_is_redirect` tinyint(1) unsigned NOT NULL DEFAULT 0,\n"
+            "  `page_is_new` tinyint(1) unsigned NOT NULL DEFAULT 0,\n"
+            "  `page_random` double unsigned NOT NULL DEFAULT 0,\n"
+            "  `page_touched` binary(14) NOT NULL,\n"
+            "  `page_links_updated` binary(14) DEFAULT NULL,\n"
+            "  `page_latest` int(10) unsigned NOT NULL,\n"
+            "  `page_len` int(10) unsigned NOT NULL,\n"
+            "  `page_content_model` varbinary(32) DEFAULT NULL,\n"
+            "  `page_lang` varbinary(35) DEFAULT NULL,\n"
+            "  PRIMARY KEY (`page_id`),\n"
+            "  UNIQUE KEY `page_name_title` (`page_namespace`,`page_title`)\n"
+            ") ENGINE=InnoDB DEFAULT CHARSET=binary;\n";
+        std::string const insert =
+            "INSERT INTO `page` VALUES "
+            "(1,0,'Ka',0,0,0.5,'20240101000000',NULL,1,100,'wikitext',NULL),"
+            "(2,0,'Lo',0,1,0.2,'20240101000000',NULL,2,100,'wikitext',NULL),"
+            "(3,0,'Mi',1,0,0.7,'20240101000000','20240101000000',3,20,"
+            "'wikitext',NULL);\n";
+        std::string const links =
+            "INSERT INTO `pagelinks` VALUES (1,0,'Lo'),(2,0,'Mi');\n";
+
+        {
+            Graph g;
+            std::istringstream pages(insert), pagelinks(links);
+            g.read_dumps(pages, pagelinks);
+            CHECK(g.size() == 3);
+            CHECK(g.nlinks() == 2);
+        }
+
+        Graph g;
+        std::istringstream pages(create + insert), pagelinks(links),
+                           redirects("INSERT INTO `redirect` VALUES "
+                                     "(3,0,'Ka','','');\n");
+        g.read_dumps(pages, pagelinks, &redirects);
+        CHECK(g.size() == 2);           // Mi redirects to Ka
+        CHECK(g.nlinks() == 2);
+    }
+
+    void check_snapshot()
+    {
+        Graph g;
+        g.assign(TITLES, LINKS);
+        std::stringstream snap;
+        g.save(snap);
+
+        Graph h;
+        h.load(snap);
+        CHECK(h.size() == g.size());
+        CHECK(h.nlinks() == g.nlinks());
+        for (unsigned i = 0; i < g.size(); i++)
+            CHECK(h.title(i) == g.title(i));
+        CHECK(same(run(g, Options()), run(h, Options())));
+    }
+
+    // Load s, with the uint32 at offset at replaced by x if at > 0
+    void load_patched(std::string s, std::size_t at, unsigned x)
+    {
+        if (at > 0)
+            std::memcpy(&s[at], &x, sizeof(x));
+        std::istringstream in(s);
+        Graph g;
+        g.load(in);
+    }
+
+    void check_corrupt_snapshot()
+    {
+        std::vector<std::string> titles = { "X", "Y" };
+        std::vector<std::pair<unsigned, unsigned> > links = { { 0, 1 } };
+        Graph g;
+        g.assign(titles, links);
+        std::ostringstream out;
+        g.save(out);
+        std::string s = out.str();
+
+        // magic and version, count, two (id, length, 1-byte title),
+        // then row 0: size, column, weight
+        std::size_t title_length = 8 + 4 + 8 + 4,
+                    row_size = 8 + 4 + 8 + 2 * (4 + 4 + 1),
+                    column = row_size + 4;
+
+        load_patched(s, 0, 0);
+        CHECK(throws<std::runtime_error>([&] {
+            load_patched(s, column, 2); }));
+        CHECK(throws<std::runtime_error>([&] {
+            load_patched(s, row_size, 3); }));
+        CHECK(throws<std::runtime_error>([&] {
+            load_patched(s, title_length, 0xFFFFFFFF); }));
+        CHECK(throws<std::runtime_error>([&] {
+            load_patched(s.substr(0, s.size() - 2), 0, 0); }));
+        CHECK(throws<std::runtime_error>([&] {
+            load_patched("not a snapshot", 0, 0); }));
+    }
+}
+
+int main()
+{
+    wikiassoc::set_logging(false);
+
+    check_assign();
+    check_run();
+    check_retry();
+    check_plan();
+    check_self_links();
+    check_empty();
+    check_read_dumps();
+    check_page_columns();
+    check_snapshot();
+    check_corrupt_snapshot();
+
+    if (failures)
+        std::cerr << "check_api: " << failures << " checks failed\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "compressed.hpp"
+
+namespace group_varint {
+    unsigned char length[256];
+    unsigned char shuffle[256][16];
+
+    namespace {
+        // Number of bytes needed for v
+        inline unsigned nbytes(boost::uint32_t v)
+        {
+            return v < (1u << 8) ? 1 : v < (1u << 16) ? 2
+                 : v < (1u << 24) ? 3 : 4;
+        }
+
+        struct FillTables
+        {
+            FillTables()
+            {
+                for (unsigned ctrl = 0; ctrl < 256; ctrl++) {
+                    unsigned in = 0;
+                    for (unsigned t = 0; t < 4; t++) {
+                        unsigned len = ((ctrl >> (2 * t)) & 3) + 1;
+                        // 0x80 makes the shuffle write a zero byte
+                        for (unsigned u = 0; u < 4; u++)
+                            shuffle[ctrl][4 * t + u] = u < len ? in + u
+                                                               : 0x80;
+                        in += len;
+                    }
+                    length[ctrl] = in;
+                }
+            }
+        } const fill_tables;
+    }
+
+    void encode(boost::uint32_t const *v, Code &out)
+    {
+        std::size_t at = out.size();
+        out.push_back(0);
+        for (unsigned t = 0; t < 4; t++) {
+            unsigned len = nbytes(v[t]);
+            out[at] |= (len - 1) << (2 * t);
+            for (unsigned u = 0; u < len; u++)
+                out.push_back((v[t] >> (8 * u)) & 0xFF);
+        }
+    }
+}
@@ -0,0 +1,317 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef COMPRESSED_HPP
+#define COMPRESSED_HPP
+
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#ifdef __SSSE3__
+#   include <tmmintrin.h>
+#endif
+
+#include "matrix.hpp"
+#include "numa.hpp"
+#include "progress.hpp"
+#include "stats.hpp"
+
+/*
+ * Group varint coding of column indices.
+ *
+ * Four 32-bit integers are stored as a control byte holding their lengths
+ * in bytes, minus one, two bits each (lowest bits first), followed by
+ * their little-endian low-order bytes. With SSSE3, a group is decoded by
+ * a single byte shuffle; otherwise, by four masked loads.
+ */
+namespace group_varint {
+    // Decoding tables, indexed by control byte; filled in at startup
+    extern unsigned char length[256];       // bytes following control
+    extern unsigned char shuffle[256][16];
+
+    // Bytes to allocate after encoded data so that decoding can read
+    // 16 bytes past any control byte
+    const std::size_t PADDING = 16;
+
+    typedef std::vector<unsigned char, FirstTouchAllocator<unsigned char> >
+        Code;
+
+    // Append the group of four integers v to out
+    void encode(boost::uint32_t const *v, Code &out);
+
+    /*
+     * Decode the group at p into four column indices, given deltas from
+     * base and the previous ones. Returns a pointer past the group;
+     * base is set to the last index.
+     */
+    inline unsigned char const *decode(unsigned char const *p,
+                                       boost::uint32_t &base,
+                                       boost::uint32_t *out)
+    {
+        unsigned char ctrl = *p++;
+
+        #ifdef __SSSE3__
+            __m128i d = _mm_shuffle_epi8(
+                _mm_loadu_si128(reinterpret_cast<__m128i const *>(p)),
+                _mm_loadu_si128(reinterpret_cast<__m128i const *>(
+                                    shuffle[ctrl])));
+            // prefix sum, then add base
+            d = _mm_add_epi32(d, _mm_slli_si128(d, 4));
+            d = _mm_add_epi32(d, _mm_slli_si128(d, 8));
+            d = _mm_add_epi32(d, _mm_set1_epi32(base));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), d);
+            base = out[3];
+        #else
+            static const boost::uint32_t mask[4] = {
+                0xFF, 0xFFFF, 0xFFFFFF, 0xFFFFFFFF
+            };
+            unsigned char const *q = p;
+            for (int t = 0; t < 4; t++) {
+                unsigned len = (ctrl >> (2 * t)) & 3;
+                boost::uint32_t v;
+                std::memcpy(&v, q, sizeof(v));      // little-endian only
+                base += v & mask[len];
+                out[t] = base;
+                q += len + 1;
+            }
+        #endif
+
+        return p + length[ctrl];
+    }
+}
+
+/**
+ * Read-only square sparse matrix with compressed rows, for use as the
+ * operands of squaring when memory is short.
+ *
+ * The column indices of each row are sorted and stored as deltas in
+ * group varint code; rows are only ever decoded as a whole. Elements are
+ * stored separately, as W.
+ */
+template <typename W>
+class CompressedMatrix {
+    // Row i has elements first[i] up to first[i+1] and its code starts
+    // at bytes[offset[i]].
+    std::vector<std::size_t> first, offset;
+    group_varint::Code bytes;
+    std::vector<W, FirstTouchAllocator<W> > values;
+
+    // Start of the group varint code of row i
+    unsigned char const *code(unsigned i) const { return &bytes[offset[i]]; }
+
+  public:
+    /**
+     * Compressed copy of m.
+     */
+    explicit CompressedMatrix(BasicMatrix<W> const &m)
+      : first(m.nrows() + 1), offset(m.nrows() + 1)
+    {
+        std::size_t n = m.nrows();
+        values.reserve(m.nnz());
+        std::vector<std::pair<unsigned, W> > row;
+
+        for (std::size_t i = 0; i < n; i++) {
+            row.assign(m.rows[i].begin(), m.rows[i].end());
+            std::sort(row.begin(), row.end(), LtByFirst);
+
+            first[i] = values.size();
+            offset[i] = bytes.size();
+
+            boost::uint32_t prev = 0;
+            for (std::size_t t = 0; t < row.size(); t += 4) {
+                boost::uint32_t delta[4] = { 0, 0, 0, 0 };
+                for (std::size_t u = t; u < t + 4 && u < row.size(); u++) {
+                    delta[u - t] = row[u].first - prev;
+                    prev = row[u].first;
+                }
+                group_varint::encode(delta, bytes);
+            }
+
+            for (std::size_t t = 0; t < row.size(); t++)
+                values.push_back(row[t].second);
+        }
+        first[n] = values.size();
+        offset[n] = bytes.size();
+        bytes.resize(bytes.size() + group_varint::PADDING);
+    }
+
+    std::size_t nrows() const { return first.size() - 1; }
+    std::size_t nnz() const { return values.size(); }
+    std::size_t row_size(unsigned i) const { return first[i + 1] - first[i]; }
+
+    /**
+     * Memory in use, in bytes.
+     */
+    std::size_t memory() const
+    {
+        return (first.capacity() + offset.capacity()) * sizeof(std::size_t)
+             + bytes.capacity() + values.capacity() * sizeof(W);
+    }
+
+    /**
+     * Call f(j, x) for each stored element (i,j) = x, in order of j.
+     */
+    template <typename F>
+    void for_each(unsigned i, F f) const
+    {
+        unsigned char const *p = code(i);
+        W const *x = values.data() + first[i];
+        std::size_t size = row_size(i);
+        boost::uint32_t base = 0, cols[4];
+
+        for (std::size_t t = 0; t < size; t += 4) {
+            p = group_varint::decode(p, base, cols);
+            std::size_t m = std::min<std::size_t>(4, size - t);
+            for (std::size_t u = 0; u < m; u++)
+                f(cols[u], x[t + u]);
+        }
+    }
+
+    /**
+     * Copy the code and elements of each row from the thread that
+     * multiplies it, so that with pinned threads, they are stored on that
+     * thread's NUMA node. Rows are scheduled as in multiply, block by
+     * block: block b is rows blocks[b] up to blocks[b+1]. Needs memory
+     * for a second copy while it runs.
+     */
+    void localize(std::vector<unsigned> const &blocks)
+    {
+        std::size_t n = nrows();
+        group_varint::Code new_bytes(bytes.size());
+        std::vector<W, FirstTouchAllocator<W> > new_values(values.size());
+
+        for (std::size_t b = 0; b + 1 < blocks.size(); b++) {
+            int i, l = blocks[b], h = blocks[b + 1];
+
+            #pragma omp parallel for schedule(static)
+            for (i=l; i<h; i++) {
+                std::copy(bytes.begin() + offset[i],
+                          bytes.begin() + offset[i + 1],
+                          new_bytes.begin() + offset[i]);
+                std::copy(values.begin() + first[i],
+                          values.begin() + first[i + 1],
+                          new_values.begin() + first[i]);
+            }
+        }
+        std::copy(bytes.begin() + offset[n], bytes.end(),
+                  new_bytes.begin() + offset[n]);      // padding
+
+        bytes.swap(new_bytes);
+        values.swap(new_values);
+    }
+
+    /**
+     * Memory that each thread allocates in multiply for a matrix of n
+     * rows, in bytes.
+     */
+    static std::size_t scratch_bytes(std::size_t n)
+    {
+        return n * (sizeof(double) + sizeof(unsigned));
+    }
+
+    /**
+     * Compute rows lo up to hi of the product of this matrix and b,
+     * storing them in r, like BasicMatrix::multiply. Rows of b are decoded
+     * as they are used. Sums are formed in double, in a dense array per
+     * thread. b may be a Replicated<CompressedMatrix>.
+     */
+    template <typename B>
+    void multiply(B const &rb, BasicMatrix<W> &r,
+                  unsigned lo, unsigned hi, WorkStats &ws) const
+    {
+        int l = lo, h = hi;
+        std::size_t flops = 0, n = nrows();
+
+        #pragma omp parallel reduction(+:flops)
+        {
+            double start = wall_time();
+            CompressedMatrix const &b = local(rb);
+            std::vector<double> acc(n);
+            std::vector<unsigned> stamp(n), touched;
+            int i;
+
+            #pragma omp for schedule(static) nowait
+            for (i=l; i<h; i++) {
+                touched.clear();
+
+                unsigned char const *p = code(i);
+                W const *x = values.data() + first[i];
+                std::size_t size = row_size(i);
+                boost::uint32_t base = 0, ks[4];
+
+                for (std::size_t t = 0; t < size; t += 4) {
+                    p = group_varint::decode(p, base, ks);
+                    std::size_t m = std::min<std::size_t>(4, size - t);
+                    for (std::size_t u = 0; u < m; u++) {
+                        unsigned k = ks[u];
+                        double aik = Real(x[t + u]);
+
+                        // Fused decoding of row k of b
+                        unsigned char const *q = b.code(k);
+                        W const *y = b.values.data() + b.first[k];
+                        std::size_t bsize = b.row_size(k);
+                        boost::uint32_t bbase = 0, js[4];
+                        for (std::size_t v = 0; v < bsize; v += 4) {
+                            q = group_varint::decode(q, bbase, js);
+                            std::size_t bm = std::min<std::size_t>(4,
+                                                                   bsize - v);
+                            for (std::size_t w = 0; w < bm; w++) {
+                                unsigned j = js[w];
+                                if (stamp[j] != unsigned(i) + 1) {
+                                    stamp[j] = i + 1;
+                                    acc[j] = 0;
+                                    touched.push_back(j);
+                                }
+                                acc[j] += aik * Real(y[v + w]);
+                            }
+                        }
+                        flops += 2 * bsize;     // multiply-add
+                    }
+                }
+
+                for (std::size_t t = 0; t < touched.size(); t++)
+                    r(i, touched[t]) = Real(acc[touched[t]]);
+                progress.rows.add();
+            }
+            ws.thread_done(start);
+        }
+        ws.flops += flops;
+    }
+
+  private:
+    static bool LtByFirst(std::pair<unsigned, W> const &x,
+                          std::pair<unsigned, W> const &y)
+    {
+        return x.first < y.first;
+    }
+};
+
+/*
+ * Add rows lo up to hi of other to *this.
+ */
+template <typename W>
+void BasicMatrix<W>::add(CompressedMatrix<W> const &other,
+                         unsigned lo, unsigned hi)
+{
+    int i, l = lo, h = hi;
+
+    #pragma omp parallel for
+    for (i=l; i<h; i++) {
+        row_type &row_i = rows[i];
+        other.for_each(i, [&row_i](unsigned j, W const &x) {
+            W &y = row_i[j];
+            y = y + x;
+        });
+    }
+}
+
+#endif  // COMPRESSED_HPP
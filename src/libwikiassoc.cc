@@ -0,0 +1,725 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * The library interface: building the graph and running the computation.
+ */
+
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "wikiassoc.hpp"
+#include "libwikiassoc.hpp"
+
+#include "article.hpp"
+#include "compressed.hpp"
+#include "ibf.hpp"
+#include "matrix.hpp"
+#include "numa.hpp"
+#include "planner.hpp"
+#include "progress.hpp"
+#include "stats.hpp"
+#include "weight.hpp"
+
+using wikiassoc::Graph;
+using wikiassoc::Options;
+using wikiassoc::Score;
+
+static_assert(std::is_same<Score, Real>::value,
+              "wikiassoc::Score must be the same type as Real");
+static_assert(wikiassoc::MAX_PATH_LENGTH == Matrix::MAX_PATH_LENGTH,
+              "wikiassoc::MAX_PATH_LENGTH differs from Matrix's");
+
+namespace {
+    // Rows sampled to estimate the size of the result
+    const unsigned PLAN_SAMPLE_SIZE = 2000;
+
+    // Rows sampled to check the accuracy of approximations
+    const unsigned RECALL_SAMPLE_SIZE = 1000;
+
+    // Bytes per element of the pf-ibf matrix when stored as precision
+    std::size_t result_bytes(std::string const &precision)
+    {
+        #define BYTES(W) if (precision == weight_name<W>()) \
+            return BasicMatrix<W>::BYTES_PER_ELEMENT;
+        FOR_EACH_WEIGHT(BYTES)
+        #undef BYTES
+        return Matrix::BYTES_PER_ELEMENT;
+    }
+
+    /*
+     * Compute pf-ibf from the ibf-weighted link matrix a and pass the
+     * associations to emit or, if plan_out is set, only print the plan
+     * there, leaving a as it is. Returns whether the plan is feasible.
+     */
+    template <typename W>
+    bool compute(BasicMatrix<W> &a, ArticleSet const &articles,
+                 Options const &opt, std::ostream *plan_out,
+                 ResultCallback const &emit, Stats &stats)
+    {
+        std::size_t n = articles.size();
+
+        // In approximate mode, paths are followed through a pruned copy
+        // of a rather than a itself.
+        bool approximate = opt.hub_threshold > 0 || opt.fanout > 0;
+        BasicMatrix<W> pruned(approximate ? n : 0);
+        if (approximate) {
+            logmsg("pruning intermediate articles");
+            stats.begin("prune");
+            std::size_t dropped = a.prune(pruned, opt.hub_threshold,
+                                          opt.fanout);
+
+            double recall = sample_recall(a, a, a, pruned, opt.n_out,
+                                          RECALL_SAMPLE_SIZE);
+            {
+                PhaseStats &ph = stats.end();
+                ph.count("dropped", dropped);
+            }
+
+            std::ostringstream msg;
+            msg << "dropped " << dropped << " of " << a.nnz()
+                << " links out of intermediate articles; recall@"
+                << opt.n_out << " on " << RECALL_SAMPLE_SIZE
+                << " sampled articles: " << recall;
+            logmsg(msg.str());
+        }
+        BasicMatrix<W> const &rhs = approximate ? pruned : a;
+
+        logmsg("planning");
+        // A thread count set by the user is taken as is; otherwise, the
+        // planner uses one thread for small graphs
+        int threads = opt.threads;
+        #ifdef _OPENMP
+            if (threads > 0)
+                omp_set_num_threads(threads);
+            else if (std::getenv("OMP_NUM_THREADS"))
+                threads = omp_get_max_threads();
+        #endif
+        stats.begin("plan");
+        // Longer paths are followed row by row, like top-k evaluation
+        bool per_row = opt.topk || opt.path_length > 2;
+        bool compress = opt.compress && !per_row;
+        Plan plan = make_plan(a, rhs, opt.memory_budget, PLAN_SAMPLE_SIZE,
+                              per_row, threads, result_bytes(opt.precision),
+                              compress
+                              ? CompressedMatrix<W>::scratch_bytes(n) : 0);
+        stats.end().count("threads", plan.threads);
+        {
+            std::ostringstream text;
+            plan.print(text);
+            if (plan_out) {
+                progress.stop();
+                *plan_out << text.str();
+                return plan.feasible;
+            }
+
+            std::istringstream lines(text.str());
+            for (std::string line; std::getline(lines, line); )
+                logmsg("plan: " + line);
+        }
+        if (!plan.feasible)
+            throw std::runtime_error("estimated memory use exceeds budget");
+
+        #ifdef _OPENMP
+            omp_set_num_threads(plan.threads);
+        #endif
+        if (opt.numa) {
+            int pinned = numa.pin(plan.threads);
+            std::ostringstream msg;
+            msg << "pinned " << pinned << " of " << plan.threads
+                << " threads to CPUs on " << numa.nodes() << " NUMA nodes";
+            logmsg(msg.str());
+        }
+
+        // With -z, the operands of squaring are compressed and their hash
+        // tables freed.
+        boost::scoped_ptr<CompressedMatrix<W> > ca, cpruned;
+        if (opt.compress && per_row)
+            logmsg("-z has no effect with -t or -l");
+        else if (compress) {
+            logmsg("compressing link matrix");
+            stats.begin("compress");
+            std::size_t nnz = a.nnz() + pruned.nnz();
+            ca.reset(new CompressedMatrix<W>(a));
+            if (approximate)
+                cpruned.reset(new CompressedMatrix<W>(pruned));
+            a.clear();
+            pruned.clear();
+
+            std::size_t before = nnz * BasicMatrix<W>::BYTES_PER_ELEMENT,
+                        after = ca->memory()
+                              + (cpruned ? cpruned->memory() : 0);
+            {
+                PhaseStats &ph = stats.end();
+                ph.count("hash_bytes", before);
+                ph.count("compressed_bytes", after);
+            }
+
+            std::ostringstream msg;
+            msg << "compressed " << nnz << " elements from about "
+                << before / 1e6 << " MB to " << after / 1e6 << " MB";
+            logmsg(msg.str());
+        }
+        CompressedMatrix<W> const *crhs = approximate ? cpruned.get()
+                                                      : ca.get();
+
+        // With -N, rows of the left operand of squaring are moved to the
+        // node of the thread that multiplies them and the right operand,
+        // which every thread reads all of, is copied to each node if
+        // memory allows.
+        Replicated<BasicMatrix<W> > hrhs(&rhs);
+        Replicated<CompressedMatrix<W> > zrhs(crhs);
+        std::size_t replicas = 1;
+        if (opt.numa && per_row)
+            logmsg("-N only pins threads with -t or -l");
+        else if (opt.numa) {
+            logmsg("placing link matrix on NUMA nodes");
+            stats.begin("numa");
+            std::size_t bytes = ca ? crhs->memory()
+                              : rhs.nnz() * BasicMatrix<W>::BYTES_PER_ELEMENT;
+            // Moving hash rows rehashes them, which changes the order of
+            // sums; compressed rows are copied whole
+            if (numa.nodes() > 1) {
+                if (!ca)
+                    a.localize(plan.blocks);
+                else if (ca->memory() < available_memory())
+                    ca->localize(plan.blocks);
+                else
+                    logmsg("not enough memory to move the link matrix");
+            }
+            if ((numa.nodes() - 1) * bytes < available_memory())
+                replicas = ca ? zrhs.replicate() : hrhs.replicate();
+            else
+                logmsg("not enough memory for a copy on each NUMA node");
+            {
+                PhaseStats &ph = stats.end();
+                ph.count("nodes", numa.nodes());
+                ph.count("pinned_threads", numa.pinned() ? plan.threads : 0);
+                ph.count("replicas", replicas);
+                ph.count("replica_bytes", (replicas - 1) * bytes);
+            }
+
+            std::ostringstream msg;
+            msg << "right operand stored " << replicas << " times, "
+                << (replicas - 1) * bytes / 1e6 << " MB extra";
+            logmsg(msg.str());
+        }
+
+        if (opt.path_length > 2) {
+            logmsg("writing output");
+            progress.phase("writing output", Progress::ROWS, a.nrows());
+            a.output_paths(rhs, opt.path_length, opt.width, opt.n_out,
+                           emit, opt.exclude, articles,
+                           stats.begin("output").work);
+            PhaseStats &ph = stats.end();
+
+            std::ostringstream msg;
+            msg << "paths of up to " << opt.path_length << " links: "
+                << ph.work.flops << " flops, against " << plan.flops
+                << " flops for length 2";
+            logmsg(msg.str());
+        } else if (opt.topk) {
+            logmsg("writing output");
+            progress.phase("writing output", Progress::ROWS, a.nrows());
+            a.output_topk(rhs, opt.n_out, emit, opt.exclude,
+                          articles, stats.begin("output").work);
+            PhaseStats &ph = stats.end();
+
+            std::ostringstream msg;
+            msg << "top-k evaluation: " << ph.work.flops << " flops and "
+                << ph.work.lookups << " lookups, against " << plan.flops
+                << " flops for full multiplication";
+            logmsg(msg.str());
+        }
+
+        // Each block of rows is squared, combined and written out, then
+        // freed. In memory, there's only one block.
+        BasicMatrix<W> r(per_row ? 0 : n);
+        for (std::size_t b = 0; !per_row && b < plan.nblocks(); b++) {
+            unsigned lo = plan.blocks[b], hi = plan.blocks[b + 1];
+
+            if (plan.nblocks() > 1) {
+                std::ostringstream msg;
+                msg << "block " << b + 1 << " of " << plan.nblocks()
+                    << ": rows " << lo << " to " << hi;
+                logmsg(msg.str());
+            }
+
+            logmsg("squaring matrix");
+            progress.phase("squaring matrix", Progress::ROWS, hi - lo);
+            if (ca)
+                ca->multiply(zrhs, r, lo, hi, stats.begin("square").work);
+            else
+                a.multiply(hrhs, r, lo, hi, stats.begin("square").work);
+            {
+                PhaseStats &ph = stats.end();
+                ph.count("nnz_r", r.nnz(lo, hi));
+                if (b == 0)     // counters add up over blocks
+                    ph.count("replicas", replicas);
+            }
+
+            logmsg("computing full pf-ibf");
+            progress.phase("computing full pf-ibf", Progress::ROWS, 0);
+            stats.begin("combine");
+            if (ca)
+                r.add(*ca, lo, hi);
+            else
+                r.add(a, lo, hi);
+            // clear diagonal, including links from articles to themselves,
+            // to avoid associating terms with themselves in output, as
+            // output_topk and output_paths do
+            r.clear_diag(lo, hi);
+            r.transform(normalize<2>, lo, hi);
+            stats.end().count("nnz_r", r.nnz(lo, hi));
+
+            logmsg("writing output");
+            progress.phase("writing output", Progress::ROWS, hi - lo);
+            r.output(opt.n_out, emit, opt.exclude, articles,
+                     lo, hi, stats.begin("output").work);
+            if (plan.nblocks() > 1)
+                r.clear(lo, hi);
+            stats.end();
+        }
+        return true;
+    }
+
+    /*
+     * Round a to storage type W, report the memory saved and how well
+     * the resulting rankings agree with those computed from a, free a
+     * and compute from the rounded copy.
+     */
+    template <typename W>
+    bool convert_and_compute(Matrix &a, ArticleSet const &articles,
+                             Options const &opt, std::ostream *plan_out,
+                             ResultCallback const &emit, Stats &stats)
+    {
+        logmsg(std::string("storing weights as ") + weight_name<W>());
+        stats.begin("convert");
+        BasicMatrix<W> converted(a);
+
+        double agreement = sample_recall(a, a, converted, converted,
+                                         opt.n_out, RECALL_SAMPLE_SIZE);
+        // Compare the weights themselves: hash table rows pad them (see
+        // BasicMatrix::BYTES_PER_ELEMENT), so only -z stores them packed
+        std::size_t nnz = a.nnz(),
+                    bytes = sizeof(W),
+                    baseline = sizeof(Real);
+        a.clear();
+        {
+            PhaseStats &ph = stats.end();
+            ph.count("weight_bytes", bytes);
+            ph.count("baseline_weight_bytes", baseline);
+        }
+
+        std::ostringstream msg;
+        msg << bytes << " bytes per weight against " << baseline << " for "
+            << weight_name<Real>() << "; link matrix weights "
+            << nnz * bytes / 1e6 << " MB against " << nnz * baseline / 1e6
+            << " MB";
+        logmsg(msg.str());
+
+        msg.str("");
+        msg << "recall@" << opt.n_out << " against " << weight_name<Real>()
+            << " on " << RECALL_SAMPLE_SIZE << " sampled articles: "
+            << agreement;
+        logmsg(msg.str());
+
+        return compute(converted, articles, opt, plan_out, emit, stats);
+    }
+
+    /*
+     * Compute from a after converting it to the storage type named by
+     * opt.precision. The plan is made from a as it is, since converting
+     * frees it.
+     */
+    bool compute_as(Matrix &a, ArticleSet const &articles,
+                    Options const &opt, std::ostream *plan_out,
+                    ResultCallback const &emit, Stats &stats)
+    {
+        if (plan_out)
+            return compute(a, articles, opt, plan_out, emit, stats);
+
+        #define CONVERT(W) if (opt.precision == weight_name<W>()) \
+            return convert_and_compute<W>(a, articles, opt, plan_out, \
+                                          emit, stats);
+        FOR_EACH_OTHER_WEIGHT(CONVERT)
+        #undef CONVERT
+        return compute(a, articles, opt, plan_out, emit, stats);
+    }
+
+    /*
+     * Restores the caller's OpenMP thread count and CPU affinity, which
+     * computing changes, when it goes out of scope.
+     */
+    class ThreadSettings
+    {
+        int threads;
+
+      public:
+        ThreadSettings() : threads(0)
+        {
+            #ifdef _OPENMP
+                threads = omp_get_max_threads();
+            #endif
+        }
+
+        ~ThreadSettings()
+        {
+            numa.unpin();
+            #ifdef _OPENMP
+                omp_set_num_threads(threads);
+            #endif
+        }
+    };
+
+    // Start of a snapshot, followed by the format version
+    char const SNAPSHOT_MAGIC[8] = { 'w', 'i', 'k', 'i', 'a', 's', 's', 'c' };
+    const boost::uint32_t SNAPSHOT_VERSION = 1;
+
+    // Longest title accepted from a snapshot; MediaWiki allows 255 bytes
+    const std::size_t MAX_SNAPSHOT_TITLE = 1 << 16;
+
+    template <typename T>
+    void put(std::ostream &out, T const &x)
+    {
+        out.write(reinterpret_cast<char const *>(&x), sizeof(x));
+    }
+
+    template <typename T>
+    T get(std::istream &in)
+    {
+        T x;
+        if (!in.read(reinterpret_cast<char *>(&x), sizeof(x)))
+            throw std::runtime_error("snapshot truncated");
+        return x;
+    }
+}
+
+wikiassoc::Options::Options()
+  : n_out(10), exclude("^$"), threads(0), memory_budget(0),
+    hub_threshold(0), fanout(0), topk(false), path_length(2), width(100),
+    precision(weight_name<Real>()), compress(false), numa(false)
+{
+}
+
+bool wikiassoc::known_precision(std::string const &name)
+{
+    #define KNOWN(W) if (name == weight_name<W>()) return true;
+    FOR_EACH_WEIGHT(KNOWN)
+    #undef KNOWN
+    return false;
+}
+
+void wikiassoc::check_options(Options const &opt)
+{
+    if (opt.path_length < 2 || opt.path_length > MAX_PATH_LENGTH)
+        throw std::invalid_argument("unsupported path length");
+
+    std::size_t size = 0;
+    #define SIZE(W) if (opt.precision == weight_name<W>()) size = sizeof(W);
+    FOR_EACH_WEIGHT(SIZE)
+    #undef SIZE
+    if (size == 0)
+        throw std::invalid_argument("unknown storage type "
+                                  + opt.precision);
+
+    // Hash table rows are padded to the same size per element for all
+    // types up to float (see BasicMatrix::BYTES_PER_ELEMENT); only the
+    // compressed layout, which -t and -l don't use, stores them packed.
+    bool per_row = opt.topk || opt.path_length > 2;
+    if (size < sizeof(Real) && (!opt.compress || per_row))
+        throw std::invalid_argument("storing weights as " + opt.precision
+                                  + " saves memory only with -z, and not"
+                                    " with -t or -l");
+}
+
+void wikiassoc::set_logging(bool on, unsigned progress_interval)
+{
+    quiet = !on;
+    if (on && progress_interval > 0)
+        progress.start(progress_interval);
+    else
+        progress.stop();
+}
+
+void wikiassoc::log(std::string const &msg)
+{
+    logmsg(msg);
+}
+
+struct Graph::Impl
+{
+    ArticleSet articles;
+    Matrix a;
+    Stats stats;
+    bool used;          // a may have been freed by running
+
+    Impl() : a(0), used(false) { }
+
+    void read(std::istream &, std::size_t, std::istream &, std::size_t,
+              std::istream *, std::size_t);
+    void weight(std::vector<unsigned> const &);
+    bool compute(Options const &, std::ostream *, ResultCallback const &);
+};
+
+/*
+ * Read the dumps, given their sizes in bytes (0 if unknown) for progress
+ * reports and statistics.
+ */
+void Graph::Impl::read(std::istream &pagefile, std::size_t page_bytes,
+                       std::istream &linkfile, std::size_t link_bytes,
+                       std::istream *redirectfile, std::size_t redirect_bytes)
+{
+    RedirectSet redirects;
+
+    progress.phase("parsing page table", Progress::BYTES, page_bytes);
+    stats.begin("parse_pages");
+    parse_pagetable(pagefile, articles, redirectfile ? &redirects : 0);
+    stats.end().bytes = page_bytes;
+
+    if (redirectfile) {
+        progress.phase("parsing redirect table", Progress::BYTES,
+                       redirect_bytes);
+        stats.begin("parse_redirects");
+        parse_redirecttable(*redirectfile, articles, redirects);
+        stats.end().bytes = redirect_bytes;
+    }
+
+    progress.phase("parsing link table", Progress::BYTES, link_bytes);
+    stats.begin("parse_links");
+    a = Matrix(articles.size());
+    std::vector<unsigned> incoming(articles.size());
+    parse_linktable(linkfile, articles, redirects, a, incoming);
+    {
+        PhaseStats &ph = stats.end();
+        ph.bytes = link_bytes;
+        ph.count("rows", articles.size());
+        ph.count("nnz_a", a.nnz());
+    }
+
+    weight(incoming);
+}
+
+/*
+ * Weight the links in a by ibf, given the number of incoming links of
+ * each article.
+ */
+void Graph::Impl::weight(std::vector<unsigned> const &incoming)
+{
+    logmsg("applying ibf transformation");
+    progress.phase("applying ibf", Progress::ROWS, 0);
+    stats.begin("ibf");
+    InverseBacklinkFrequency ibf(incoming);
+    a.transform(ibf);
+    stats.end();
+}
+
+bool Graph::Impl::compute(Options const &opt, std::ostream *plan_out,
+                          ResultCallback const &emit)
+{
+    check_options(opt);
+    if (used)
+        throw std::logic_error("graph has already been computed from");
+
+    ThreadSettings saved;
+    std::size_t nnz = a.nnz();
+    bool feasible;
+    try {
+        feasible = compute_as(a, articles, opt, plan_out, emit, stats);
+    } catch (...) {
+        // Can be retried unless the link matrix was freed
+        used = a.nnz() != nnz;
+        throw;
+    }
+    used = !plan_out;
+    return feasible;
+}
+
+Graph::Graph() : impl(new Impl) { }
+
+Graph::~Graph() { }
+
+void Graph::read_dumps(char const *pagedump, char const *linkdump,
+                       char const *redirectdump)
+{
+    // fail early if input files not readable
+    boost::scoped_ptr<std::istream> pagefile(open_input(pagedump)),
+                                    linkfile(open_input(linkdump)),
+                                    redirectfile(redirectdump
+                                               ? open_input(redirectdump)
+                                               : 0);
+
+    impl.reset(new Impl);
+    impl->read(*pagefile, file_size(pagedump), *linkfile, file_size(linkdump),
+               redirectfile.get(), redirectdump ? file_size(redirectdump) : 0);
+}
+
+void Graph::read_dumps(std::istream &pages, std::istream &links,
+                       std::istream *redirects)
+{
+    impl.reset(new Impl);
+    impl->read(pages, 0, links, 0, redirects, 0);
+}
+
+void Graph::assign(std::vector<std::string> const &titles,
+                   std::vector<std::pair<unsigned, unsigned> > const &links)
+{
+    impl.reset(new Impl);
+    ArticleSet &articles = impl->articles;
+    Matrix &a = impl->a;
+    std::size_t n = titles.size();
+
+    progress.phase("building graph", Progress::ROWS, 0);
+    impl->stats.begin("assign");
+    for (std::size_t i = 0; i < n; i++)
+        if (!articles.push_back(Article(titles[i], i)).second)
+            throw std::invalid_argument("duplicate title " + titles[i]);
+
+    a = Matrix(n);
+    std::vector<unsigned> incoming(n);
+    for (std::size_t l = 0; l < links.size(); l++) {
+        unsigned from = links[l].first, to = links[l].second;
+        if (from >= n || to >= n)
+            throw std::out_of_range("link to or from unknown article");
+
+        Real &link = a(from, to);
+        if (link != 0.)
+            continue;
+        link = 1.;
+        incoming[to] += 1;
+    }
+    {
+        PhaseStats &ph = impl->stats.end();
+        ph.count("rows", n);
+        ph.count("nnz_a", a.nnz());
+    }
+
+    impl->weight(incoming);
+}
+
+/*
+ * A snapshot holds the magic string and version, the number of articles,
+ * their database ids and titles, then each row of the ibf-weighted link
+ * matrix as its size followed by (column, weight) pairs, all in native
+ * byte order.
+ */
+void Graph::save(std::ostream &out) const
+{
+    ArticleSet const &articles = impl->articles;
+    Matrix const &a = impl->a;
+    if (impl->used)
+        throw std::logic_error("graph has already been computed from");
+
+    logmsg("saving snapshot");
+    out.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    put(out, SNAPSHOT_VERSION);
+    put(out, boost::uint64_t(articles.size()));
+
+    for (std::size_t i = 0; i < articles.size(); i++) {
+        put(out, boost::uint32_t(articles[i].db_id));
+        put(out, boost::uint32_t(articles[i].title.size()));
+        out.write(articles[i].title.data(), articles[i].title.size());
+    }
+
+    for (std::size_t i = 0; i < a.nrows(); i++) {
+        put(out, boost::uint32_t(a.row_size(i)));
+        a.for_each(i, [&out](unsigned j, Real x) {
+            put(out, boost::uint32_t(j));
+            put(out, x);
+        });
+    }
+
+    if (!out)
+        throw std::runtime_error("error writing snapshot");
+}
+
+void Graph::load(std::istream &in)
+{
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    if (!in.read(magic, sizeof(magic))
+     || !std::equal(magic, magic + sizeof(magic), SNAPSHOT_MAGIC)
+     || get<boost::uint32_t>(in) != SNAPSHOT_VERSION)
+        throw std::runtime_error("not a wikiassoc snapshot");
+
+    impl.reset(new Impl);
+    ArticleSet &articles = impl->articles;
+    Matrix &a = impl->a;
+
+    logmsg("loading snapshot");
+    progress.phase("loading snapshot", Progress::ROWS, 0);
+    impl->stats.begin("load");
+    std::size_t n = get<boost::uint64_t>(in);
+    std::string title;
+    for (std::size_t i = 0; i < n; i++) {
+        unsigned id = get<boost::uint32_t>(in);
+        std::size_t length = get<boost::uint32_t>(in);
+        if (length > MAX_SNAPSHOT_TITLE)
+            throw std::runtime_error("corrupt snapshot: title too long");
+        title.resize(length);
+        if (!in.read(&title[0], title.size()))
+            throw std::runtime_error("snapshot truncated");
+        if (!articles.push_back(Article(title, id)).second)
+            throw std::runtime_error("corrupt snapshot: duplicate title");
+    }
+
+    a = Matrix(n);
+    for (std::size_t i = 0; i < n; i++) {
+        std::size_t size = get<boost::uint32_t>(in);
+        if (size > n)
+            throw std::runtime_error("corrupt snapshot: row too long");
+        for (std::size_t t = 0; t < size; t++) {
+            std::size_t j = get<boost::uint32_t>(in);
+            if (j >= n)
+                throw std::runtime_error("corrupt snapshot: link to "
+                                         "unknown article");
+            a(i, j) = get<Real>(in);
+        }
+        progress.rows.add();
+    }
+    {
+        PhaseStats &ph = impl->stats.end();
+        ph.count("rows", n);
+        ph.count("nnz_a", a.nnz());
+    }
+}
+
+std::size_t Graph::size() const { return impl->articles.size(); }
+
+std::size_t Graph::nlinks() const { return impl->a.nnz(); }
+
+std::string const &Graph::title(unsigned i) const
+{
+    return impl->articles[i].title;
+}
+
+bool Graph::plan(Options const &opt, std::ostream &out)
+{
+    return impl->compute(opt, &out, ResultCallback());
+}
+
+void Graph::run(Options const &opt, ResultCallback const &results)
+{
+    impl->compute(opt, 0, results);
+}
+
+void Graph::write_stats(std::ostream &out) const
+{
+    impl->stats.write_json(out);
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * C++ interface to the wikiassoc library.
+ *
+ * A Graph of articles and the links between them is built from MediaWiki
+ * SQL dumps, from a snapshot saved earlier or from in-memory edge lists.
+ * Running it computes pf-ibf and passes the top associations of each
+ * article to a callback, instead of writing them out as text:
+ *
+ *     wikiassoc::Graph g;
+ *     g.read_dumps("page.sql.gz", "pagelinks.sql.gz");
+ *     wikiassoc::Options opt;
+ *     opt.n_out = 20;
+ *     g.run(opt, [&g](unsigned i,
+ *                     std::vector<wikiassoc::Association> const &rel) {
+ *         ...     // g.title(i), g.title(rel[0].first), rel[0].second
+ *     });
+ *
+ * The wikiassoc program is a client of this interface.
+ */
+
+#ifndef LIBWIKIASSOC_HPP
+#define LIBWIKIASSOC_HPP
+
+#include <boost/regex.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace wikiassoc {
+    // Type of pf-ibf scores
+    typedef float Score;
+
+    // Associated article and its score
+    typedef std::pair<unsigned, Score> Association;
+
+    /**
+     * Receiver of the associations of article i, best first. When running
+     * in parallel, it is called from several threads at once.
+     */
+    typedef std::function<void (unsigned i,
+                                std::vector<Association> const &)>
+        ResultCallback;
+
+    // Longest path length supported (Options::path_length)
+    const unsigned MAX_PATH_LENGTH = 6;
+
+    /**
+     * Settings for computing associations; see wikiassoc(1) for details.
+     */
+    struct Options
+    {
+        std::size_t n_out;      // number of associations per article
+        boost::regex exclude;   // titles not to associate or output
+        int threads;            // 0 means OMP_NUM_THREADS or all CPUs,
+                                // but one for small graphs
+        std::size_t memory_budget;      // bytes; 0 means all available
+        Score hub_threshold;            // approximate: -H
+        std::size_t fanout;             // approximate: -F; 0 = unlimited
+        bool topk;                      // -t
+        unsigned path_length;           // -l
+        std::size_t width;              // -b; 0 means unlimited
+        std::string precision;          // -P
+        bool compress;                  // -z
+        bool numa;                      // -N
+
+        Options();
+    };
+
+    /**
+     * Whether name is a storage type accepted by Options::precision.
+     */
+    bool known_precision(std::string const &name);
+
+    /**
+     * Throw std::invalid_argument if opt is inconsistent: a path length
+     * out of range, or a storage type smaller than float without
+     * compression, where it would lose precision but save no memory.
+     * Called by Graph::plan and Graph::run.
+     */
+    void check_options(Options const &opt);
+
+    /**
+     * Log to standard error (on by default) or not. While on, progress
+     * is reported every progress_interval seconds; 0 stops reporting.
+     */
+    void set_logging(bool on, unsigned progress_interval = 0);
+
+    // Write msg to the log
+    void log(std::string const &msg);
+
+    /**
+     * Articles and the links between them, weighted by ibf.
+     *
+     * Each read, assign or load replaces the whole graph. Running may
+     * free the link matrix to save memory, so a graph can be run only
+     * once; planning leaves it as it is.
+     */
+    class Graph
+    {
+        struct Impl;
+        boost::scoped_ptr<Impl> impl;
+
+        Graph(Graph const &);
+        Graph &operator=(Graph const &);
+
+      public:
+        Graph();
+        ~Graph();
+
+        /**
+         * Read MediaWiki page and pagelinks table dumps, and optionally
+         * a redirect table dump, from files (optionally compressed with
+         * gzip or bzip2). All files are opened before any is read.
+         */
+        void read_dumps(char const *pagedump, char const *linkdump,
+                        char const *redirectdump = 0);
+
+        // Same, from streams of uncompressed SQL
+        void read_dumps(std::istream &pages, std::istream &links,
+                        std::istream *redirects = 0);
+
+        /**
+         * Build the graph from in-memory article titles, which must be
+         * distinct, and links between them as (from, to) indices into
+         * titles. Repeated links count once.
+         */
+        void assign(std::vector<std::string> const &titles,
+                    std::vector<std::pair<unsigned, unsigned> > const &links);
+
+        /**
+         * Write a snapshot of the graph, to be read back by load without
+         * parsing the dumps again. Not portable across architectures.
+         * Scores computed from a loaded snapshot may differ in the last
+         * digits, since they are summed in a different order. load
+         * throws std::runtime_error if in is not a valid snapshot.
+         */
+        void save(std::ostream &) const;
+        void load(std::istream &);
+
+        std::size_t size() const;       // number of articles
+        std::size_t nlinks() const;
+        std::string const &title(unsigned i) const;
+
+        /**
+         * Print the execution plan for opt to out, without computing
+         * anything. Returns whether it fits in the memory budget. The
+         * plan is made before weights are converted to opt.precision, so
+         * "memory in use" is that of float weights.
+         */
+        bool plan(Options const &opt, std::ostream &out);
+
+        /**
+         * Compute the associations of all articles under opt and pass
+         * them to results, in no particular order. Throws
+         * std::runtime_error if the plan doesn't fit in memory, after
+         * which the graph can be run again. The caller's OpenMP thread
+         * count and CPU affinity are restored on return.
+         */
+        void run(Options const &opt, ResultCallback const &results);
+
+        /**
+         * Write statistics for each phase done so far as JSON.
+         */
+        void write_stats(std::ostream &) const;
+    };
+}
+
+#endif  // LIBWIKIASSOC_HPP
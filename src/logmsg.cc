@@ -10,17 +10,25 @@
 #include <cstring>
 #include <ctime>
 #include <iostream>
+#include <mutex>
 
 #include "config.h"
 #include "wikiassoc.hpp"
 
 bool quiet = false;
 
+namespace {
+    // Progress reports are logged from a separate thread
+    std::mutex log_mutex;
+}
+
 void logmsg(char const *msg)
 {
     if (quiet)
         return;
 
+    std::lock_guard<std::mutex> lock(log_mutex);
+
     time_t t = std::time(0);
     char *timetxt = std::ctime(&t);         // XXX: not reentrant
     *std::strchr(timetxt, '\n') = '\0';     // ISO guarantees a '\n'
@@ -7,61 +7,220 @@
  * (at your option) any later version.
  */
 
+/*
+ * The wikiassoc program: reads the dumps named on the command line and
+ * writes associations as text, through the library interface.
+ */
+
 #include <boost/lexical_cast.hpp>
-#include <boost/scoped_ptr.hpp>
 #include <cstdlib>
+#include <fstream>
+#include <getopt.h>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <unistd.h>
 
-#include "wikiassoc.hpp"
-
-#include "article.hpp"
-#include "ibf.hpp"
-#include "matrix.hpp"
+#include "libwikiassoc.hpp"
 
 namespace {
     void usage(char const *progname)
     {
         std::cerr << "usage: " << progname
-                  << " [-e RE] [-n N] [-qw] pagedump linkdump\n"
+                  << " [-b W] [-e RE] [-F M] [-H T] [-l L] [-m MB] [-n N]"
+                     " [-p SECS] [-P TYPE]"
+                     " [-r redirectdump] [-s statsfile] [-dNqtwz]"
+                     " pagedump linkdump\n"
+                  << "    -b W   with -l, expand only the W articles with the\n"
+                  << "           heaviest paths after the second hop;"
+                     " default 100, 0 for all\n"
+                  << "    -d     dry run; print execution plan and exit\n"
+                  << "           (also --dry-run)\n"
                   << "    -e RE  exclude titles matching RE in output\n"
+                  << "    -F M   approximate: follow only the M links with\n"
+                  << "           highest ibf out of each intermediate article\n"
+                  << "    -H T   approximate: skip intermediate articles\n"
+                  << "           through which no path scores T or more\n"
+                  << "    -l L   follow paths of up to L links, default 2\n"
+                  << "           (also --path-length L)\n"
+                  << "    -m MB  memory budget, default all available memory\n"
+                  << "           (also --memory MB)\n"
                   << "    -n N   output N associations per term, default 10\n"
+                  << "    -N     pin threads to CPUs, keep link matrix on\n"
+                  << "           each NUMA node (also --numa)\n"
+                  << "    -p S   log progress every S seconds, default 60;"
+                     " 0 to disable\n"
+                  << "    -P T   store weights as T: float (default), double,\n"
+                  << "           bf16, log16 or log8 (also --precision T);\n"
+                  << "           types smaller than float need -z\n"
                   << "    -q     quiet; no log output to standard error\n"
+                  << "    -r F   collapse redirects using redirect table dump F\n"
+                  << "    -s F   write per-phase statistics as JSON to F\n"
+                  << "           (also --stats F)\n"
+                  << "    -t     compute only the top N of each row, pruning\n"
+                  << "           paths that can't make it; same output\n"
                   << "    -w     output pf-ibf weights with associations\n"
+                  << "    -z     compress the link matrix before squaring\n"
         ;
         std::exit(1);
     }
+
+    struct option const long_options[] = {
+        { "dry-run",     no_argument,       0, 'd' },
+        { "path-length", required_argument, 0, 'l' },
+        { "memory",      required_argument, 0, 'm' },
+        { "numa",        no_argument,       0, 'N' },
+        { "precision",   required_argument, 0, 'P' },
+        { "stats",       required_argument, 0, 's' },
+        { 0, 0, 0, 0 }
+    };
+
+    /*
+     * Writes the stanza for each article and its associations to
+     * std::cout. Thread-safe.
+     */
+    class TextWriter
+    {
+        wikiassoc::Graph const &graph;
+        bool weights;
+        std::mutex &mtx;
+
+      public:
+        TextWriter(wikiassoc::Graph const &g, bool w, std::mutex &m)
+          : graph(g), weights(w), mtx(m) { }
+
+        void operator()(unsigned i,
+                        std::vector<wikiassoc::Association> const &related)
+        {
+            std::stringstream s;
+            s << graph.title(i) << "\n";
+            for (size_t j=0; j<related.size(); j++) {
+                s << "    " << graph.title(related[j].first);
+                if (weights)
+                    s << " " << related[j].second;
+                s << "\n";
+            }
+
+            std::lock_guard<std::mutex> lock(mtx);
+            std::cout << s.rdbuf();
+        }
+    };
+
+    void write_stats(wikiassoc::Graph const &graph, std::ofstream &out,
+                     char const *path)
+    {
+        graph.write_stats(out);
+        out.close();
+        if (!out)
+            throw std::runtime_error(std::string("error writing ") + path);
+    }
 }
 
 int main(int argc, char *argv[])
 {
-    bool output_weights = false;
-    boost::regex exclude("^$");
-    std::size_t n_out = 10;    // number of associations per term to output
+    wikiassoc::Options opt;
+    bool dry_run = false, output_weights = false, quiet = false;
+    char const *redirectdump = 0;
+    char const *statsfile = 0;
+    unsigned progress_interval = 60;
 
     try {
-        for (int opt; (opt = getopt(argc, argv, "e:n:qw")) != -1; ) {
-            switch (opt) {
+        char const *optstring = "b:de:F:H:l:m:n:Np:P:qr:s:twz";
+        for (int c; (c = getopt_long(argc, argv, optstring,
+                                     long_options, 0)) != -1; ) {
+            switch (c) {
+              case 'b':
+                try {
+                    opt.width = boost::lexical_cast<std::size_t>(optarg);
+                } catch (boost::bad_lexical_cast const &e) {
+                    usage(argv[0]);
+                }
+                break;
+              case 'd':
+                dry_run = true;
+                break;
               case 'e':
-                exclude = optarg;
+                opt.exclude = optarg;
+                break;
+              case 'F':
+                try {
+                    opt.fanout = boost::lexical_cast<std::size_t>(optarg);
+                } catch (boost::bad_lexical_cast const &e) {
+                    usage(argv[0]);
+                }
+                break;
+              case 'H':
+                try {
+                    opt.hub_threshold = boost::lexical_cast<wikiassoc::Score>(optarg);
+                } catch (boost::bad_lexical_cast const &e) {
+                    usage(argv[0]);
+                }
+                break;
+              case 'l':
+                try {
+                    opt.path_length = boost::lexical_cast<unsigned>(optarg);
+                } catch (boost::bad_lexical_cast const &e) {
+                    usage(argv[0]);
+                }
+                if (opt.path_length < 2
+                 || opt.path_length > wikiassoc::MAX_PATH_LENGTH)
+                    usage(argv[0]);
+                break;
+              case 'm':
+                try {
+                    opt.memory_budget
+                        = boost::lexical_cast<std::size_t>(optarg) << 20;
+                } catch (boost::bad_lexical_cast const &e) {
+                    usage(argv[0]);
+                }
                 break;
               case 'n':
                 try {
-                    n_out = boost::lexical_cast<std::size_t>(optarg);
+                    opt.n_out = boost::lexical_cast<std::size_t>(optarg);
                 } catch (boost::bad_lexical_cast const &e) {
                     usage(argv[0]);
                 }
                 break;
+              case 'N':
+                opt.numa = true;
+                break;
+              case 'p':
+                try {
+                    progress_interval = boost::lexical_cast<unsigned>(optarg);
+                } catch (boost::bad_lexical_cast const &e) {
+                    usage(argv[0]);
+                }
+                break;
+              case 'P':
+                opt.precision = optarg;
+                if (!wikiassoc::known_precision(opt.precision))
+                    usage(argv[0]);
+                break;
               case 'q':
                 quiet = true;
                 break;
+              case 'r':
+                redirectdump = optarg;
+                break;
+              case 's':
+                statsfile = optarg;
+                break;
+              case 't':
+                opt.topk = true;
+                break;
               case 'w':
                 output_weights = true;
                 break;
+              case 'z':
+                opt.compress = true;
+                break;
               default:
                 usage(argv[0]);
             }
         }
+        wikiassoc::check_options(opt);
+
         argc -= optind;
         if (argc != 2)
             usage(argv[0]);
@@ -70,46 +229,45 @@ int main(int argc, char *argv[])
         // Boost.Regex error messages tend to be descriptive enough
         std::cerr << argv[0] << ": error: " << e.what() << std::endl;
         return 1;
+    } catch (std::invalid_argument const &e) {
+        std::cerr << argv[0] << ": error: " << e.what() << std::endl;
+        return 1;
     }
 
     try {
-        // fail early if input files not readable
-        boost::scoped_ptr<std::istream> pagefile(open_input(argv[0])),
-                                        linkfile(open_input(argv[1]));
-
-        ArticleSet articles;
-
-        parse_pagetable(*pagefile, articles);
-        pagefile.reset();
-
-        Matrix a(articles.size()),
-               r(articles.size());
-        std::vector<unsigned> incoming(articles.size());
-        parse_linktable(*linkfile, articles, a, incoming);
-        linkfile.reset();
+        std::ofstream statsout;
+        if (statsfile) {
+            statsout.open(statsfile);
+            if (!statsout)
+                throw std::runtime_error(std::string("cannot open ")
+                                       + statsfile);
+        }
 
-        logmsg("applying ibf transformation");
-        InverseBacklinkFrequency ibf(incoming);
-        a.transform(ibf);
+        wikiassoc::set_logging(!quiet, progress_interval);
 
-        logmsg("squaring matrix");
-        a.square(r);
+        wikiassoc::Graph graph;
+        graph.read_dumps(argv[0], argv[1], redirectdump);
 
-        logmsg("computing full pf-ibf");
-        // clear diagonal to avoid associating terms with themselves in output
-        r.clear_diag();
-        r += a;
-        r.transform(normalize<2>);
+        int status = 0;
+        if (dry_run)
+            status = graph.plan(opt, std::cout) ? 0 : 1;
+        else {
+            std::mutex mtx;
+            graph.run(opt, TextWriter(graph, output_weights, mtx));
+        }
+        wikiassoc::set_logging(!quiet);
 
-        logmsg("writing output");
-        r.output(n_out, output_weights, exclude, articles);
+        if (statsfile)
+            write_stats(graph, statsout, statsfile);
 
-        logmsg("done");
+        if (!dry_run)
+            wikiassoc::log("done");
+        return status;
     } catch (std::bad_alloc const &e) {
-        logmsg("FATAL: out of memory");
+        wikiassoc::log("FATAL: out of memory");
         return 1;
     } catch (std::exception const &e) {
-        logmsg(std::string("FATAL: ") + e.what());
+        wikiassoc::log(std::string("FATAL: ") + e.what());
         return 1;
     }
 }
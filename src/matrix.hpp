@@ -14,10 +14,10 @@
 
 #ifdef HAVE_GOOGLE_SPARSE_HASH_MAP
 #   include <google/sparse_hash_map>
-#else
-#   include <boost/unordered_map.hpp>
 #endif
 
+#include <boost/unordered_map.hpp>
+
 #include <boost/regex.hpp>
 #include <algorithm>
 #include <iosfwd>
@@ -25,25 +25,51 @@
 #include <utility>
 #include <vector>
 
+#include "numa.hpp"
+#include "progress.hpp"
+#include "stats.hpp"
+#include "weight.hpp"
+
+template <typename W> class CompressedMatrix;
+
 /**
- * Square sparse matrices.
+ * Square sparse matrices, with elements stored as W (float, double or
+ * one of the types in weight.hpp) and read as Real.
  *
  * TODO: reorder pf-ibf computations to allow for symmetric matrices
  * (see operator()) and cut memory use by half.
  */
-class Matrix {
+template <typename W>
+class BasicMatrix {
+    template <typename V> friend class BasicMatrix;
+    friend class CompressedMatrix<W>;
+
     #ifdef HAVE_GOOGLE_SPARSE_HASH_MAP
-        typedef google::sparse_hash_map<unsigned, Real> row_type;
+        typedef google::sparse_hash_map<unsigned, W> row_type;
         // google::sparse_hash_map wants a special "deleted key" value
         // to enable erase() to work
         static const unsigned DELETED = UINT_MAX;
     #else
-        typedef boost::unordered_map<unsigned, Real> row_type;
+        typedef boost::unordered_map<unsigned, W> row_type;
     #endif
     std::vector<row_type> rows;
 
   public:
-    Matrix(unsigned nr) : rows(nr)
+    // Approximate memory use per stored element, including hash table
+    // overhead; measured on 64-bit Linux with float elements. Used for
+    // planning.
+    #ifdef HAVE_GOOGLE_SPARSE_HASH_MAP
+        static const std::size_t BYTES_PER_ELEMENT
+            = 8 + sizeof(typename row_type::value_type);
+    #else
+        static const std::size_t BYTES_PER_ELEMENT
+            = 36 + sizeof(typename row_type::value_type);
+    #endif
+
+    // Longest path length supported by output_paths
+    static const unsigned MAX_PATH_LENGTH = 6;
+
+    BasicMatrix(unsigned nr) : rows(nr)
     {
         #ifdef HAVE_GOOGLE_SPARSE_HASH_MAP
             int i, n = nrows();
@@ -54,6 +80,26 @@ class Matrix {
         #endif
     }
 
+    /**
+     * Copy of other, with its elements rounded to W.
+     */
+    template <typename V>
+    explicit BasicMatrix(BasicMatrix<V> const &other) : rows(other.nrows())
+    {
+        int i, n = nrows();
+
+        #pragma omp parallel for
+        for (i=0; i<n; i++) {
+            #ifdef HAVE_GOOGLE_SPARSE_HASH_MAP
+                rows[i].set_deleted_key(DELETED);
+            #endif
+            for (typename BasicMatrix<V>::row_type::const_iterator
+                     ij = other.rows[i].begin(), end = other.rows[i].end();
+                 ij != end; ++ij)
+                rows[i][ij->first] = Real(ij->second);
+        }
+    }
+
     /**
      * Returns the element at row i, column j.
      * 0 if no element present.
@@ -62,7 +108,7 @@ class Matrix {
     {
 //      if (i < j)
 //          std::swap(i,j);
-        row_type::const_iterator rij = rows[i].find(j);
+        typename row_type::const_iterator rij = rows[i].find(j);
         return (rij == rows[i].end()) ? 0. : rij->second;
     }
 
@@ -70,7 +116,7 @@ class Matrix {
      * Returns a reference to the element at row i, column j.
      * Stores 0 if no element present.
      */
-    Real &operator()(unsigned i, unsigned j)
+    W &operator()(unsigned i, unsigned j)
     {
 //      if (i < j)
 //          std::swap(i,j);
@@ -78,97 +124,357 @@ class Matrix {
     }
 
     /**
-     * Add the smaller matrix other to *this. This function takes a shortcut
-     * by assuming that if other(i,j) is non-zero, then so is (*this)(i,j)
-     * (which is true when adding a matrix to its square).
+     * Call f(j, x) for each stored element (i,j) = x, in no particular
+     * order.
+     */
+    template <typename F>
+    void for_each(unsigned i, F f) const
+    {
+        for (typename row_type::const_iterator ij = rows[i].begin(),
+                                               end = rows[i].end();
+             ij != end; ++ij)
+            f(ij->first, ij->second);
+    }
+
+    /**
+     * Add rows lo up to hi of other to *this.
      */
-    Matrix &operator+=(Matrix const &other)
+    void add(BasicMatrix const &other, unsigned lo, unsigned hi)
     {
-        int i, n = nrows();
+        int i, l = lo, h = hi;
 
         #pragma omp parallel for
-        for (i=0; i<n; i++) {
+        for (i=l; i<h; i++) {
             row_type &row_i = rows[i];
-            for (row_type::const_iterator ij  = other.rows[i].begin(),
-                                          end = other.rows[i].end();
+            for (typename row_type::const_iterator ij  = other.rows[i].begin(),
+                                                   end = other.rows[i].end();
                  ij != end; ++ij) {
-                unsigned j = ij->first;
-                row_i[j] += ij->second;
+                W &x = row_i[ij->first];
+                x = x + ij->second;
             }
         }
+    }
+
+    // Defined in compressed.hpp
+    void add(CompressedMatrix<W> const &other, unsigned lo, unsigned hi);
+
+    BasicMatrix &operator+=(BasicMatrix const &other)
+    {
+        add(other, 0, nrows());
         return *this;
     }
 
     /**
-     * Clear the matrix, resetting all values to 0.
+     * Clear rows lo up to hi, resetting all values to 0 and releasing
+     * their memory.
      */
-    void clear()
+    void clear(unsigned lo, unsigned hi)
     {
-        int i, n = nrows();
+        int i, l = lo, h = hi;
 
         #pragma omp parallel for
-        for (i=0; i<n; i++)
-            rows[i].clear();
+        for (i=l; i<h; i++) {
+            row_type().swap(rows[i]);
+            #ifdef HAVE_GOOGLE_SPARSE_HASH_MAP
+                rows[i].set_deleted_key(DELETED);
+            #endif
+        }
     }
 
-    void clear_diag()
+    void clear() { clear(0, nrows()); }
+
+    /**
+     * Reallocate each row from the thread that multiplies it, so that
+     * with pinned threads, it is stored on that thread's NUMA node.
+     * Rows are scheduled as in multiply, block by block: block b is rows
+     * blocks[b] up to blocks[b+1].
+     */
+    void localize(std::vector<unsigned> const &blocks)
     {
-        int i, n = nrows();
+        for (std::size_t b = 0; b + 1 < blocks.size(); b++) {
+            int i, l = blocks[b], h = blocks[b + 1];
+
+            #pragma omp parallel for schedule(static)
+            for (i=l; i<h; i++) {
+                row_type copy(rows[i]);
+                copy.swap(rows[i]);
+            }
+        }
+    }
+
+    void clear_diag(unsigned lo, unsigned hi)
+    {
+        int i, l = lo, h = hi;
 
         #pragma omp parallel for
-        for (i=0; i<n; i++)
+        for (i=l; i<h; i++)
             rows[i].erase(i);
     }
 
-    void output(std::size_t, bool, boost::regex const &, ArticleSet const &)
-        const;
+    void clear_diag() { clear_diag(0, nrows()); }
+
+    void output(std::size_t, ResultCallback const &, boost::regex const &,
+                ArticleSet const &, unsigned, unsigned, WorkStats &) const;
+    void output_topk(BasicMatrix const &, std::size_t, ResultCallback const &,
+                     boost::regex const &, ArticleSet const &,
+                     WorkStats &) const;
+    void output_paths(BasicMatrix const &, unsigned, std::size_t, std::size_t,
+                      ResultCallback const &, boost::regex const &,
+                      ArticleSet const &, WorkStats &) const;
 
     /**
      * Apply transformation (function/functional) op to all non-zero elements
+     * in rows lo up to hi
      */
     template <typename F>
-    void transform(F const &op)
+    void transform(F const &op, unsigned lo, unsigned hi)
     {
-        int i, n = nrows();
+        int i, l = lo, h = hi;
 
         #pragma omp parallel for
-        for (i=0; i<n; ++i)
-            for (row_type::iterator ij=rows[i].begin(),
-                                    end=rows[i].end();
+        for (i=l; i<h; ++i)
+            for (typename row_type::iterator ij=rows[i].begin(),
+                                             end=rows[i].end();
                  ij != end; ++ij)
                 ij->second = op(ij->first, ij->second);
     }
 
+    template <typename F>
+    void transform(F const &op) { transform(op, 0, nrows()); }
+
     size_t nrows() const { return rows.size(); }
 
     /**
-     * Square this matrix, storing the result in r.
-     * r must be empty (all zero).
+     * Number of stored (non-zero) elements in row i
      */
-    void square(Matrix &r) const { mult(*this, *this, r); }
+    size_t row_size(unsigned i) const { return rows[i].size(); }
 
-  private:
-    static void mult(Matrix const &a, Matrix const &b, Matrix &r)
+    /**
+     * Number of stored (non-zero) elements, in rows lo up to hi or in total
+     */
+    size_t nnz(unsigned lo, unsigned hi) const
     {
-        int i, n = a.nrows();
+        size_t total = 0;
+        for (size_t i=lo; i<hi; i++)
+            total += rows[i].size();
+        return total;
+    }
 
-        #pragma omp parallel for
+    size_t nnz() const { return nnz(0, nrows()); }
+
+    /**
+     * Number of floating-point operations needed to compute row i of
+     * the product of this matrix and b.
+     */
+    size_t product_row_flops(BasicMatrix const &b, unsigned i) const
+    {
+        size_t flops = 0;
+        for (typename row_type::const_iterator ik = rows[i].begin(),
+                                               end = rows[i].end();
+             ik != end; ++ik)
+            flops += 2 * b.rows[ik->first].size();
+        return flops;
+    }
+
+    /**
+     * Number of non-zeros in row i of this matrix plus its product with b
+     * (the full pf-ibf matrix for path length 2, before the diagonal
+     * is cleared). Costs about as much as computing the row.
+     */
+    size_t product_row_nnz(BasicMatrix const &b, unsigned i) const
+    {
+        std::vector<unsigned> cols;
+        for (typename row_type::const_iterator ik = rows[i].begin(),
+                                               end = rows[i].end();
+             ik != end; ++ik) {
+            cols.push_back(ik->first);
+            row_type const &bk = b.rows[ik->first];
+            for (typename row_type::const_iterator kj = bk.begin(),
+                                                   kend = bk.end();
+                 kj != kend; ++kj)
+                cols.push_back(kj->first);
+        }
+        std::sort(cols.begin(), cols.end());
+        return std::unique(cols.begin(), cols.end()) - cols.begin();
+    }
+
+    /**
+     * Compute row i of this matrix plus its product with b, without the
+     * diagonal element, into out. For checking results on single rows.
+     */
+    void product_row(BasicMatrix const &b, unsigned i,
+                     std::vector<std::pair<unsigned, Real> > &out) const
+    {
+        boost::unordered_map<unsigned, Real> ri;
+        for (typename row_type::const_iterator ik = rows[i].begin(),
+                                               end = rows[i].end();
+             ik != end; ++ik) {
+            ri[ik->first] += ik->second;
+            row_type const &bk = b.rows[ik->first];
+            for (typename row_type::const_iterator kj = bk.begin(),
+                                                   kend = bk.end();
+                 kj != kend; ++kj)
+                ri[kj->first] += Real(ik->second) * Real(kj->second);
+        }
+        ri.erase(i);
+        out.assign(ri.begin(), ri.end());
+    }
+
+    /**
+     * Store in out a copy of this matrix for use as the right-hand
+     * operand in approximate squaring. Element (k,j) is dropped if no
+     * path through it can contribute threshold or more to a pf-ibf
+     * score, i.e. if it times the largest element in column k is below
+     * threshold. Of the remaining elements, each row keeps only its
+     * fanout largest (all if fanout == 0). out must be empty.
+     *
+     * Returns the number of elements dropped.
+     */
+    size_t prune(BasicMatrix &out, Real threshold, size_t fanout) const
+    {
+        int i, n = nrows();
+
+        std::vector<Real> colmax(n);
+        for (i=0; i<n; i++)
+            for (typename row_type::const_iterator ij = rows[i].begin(),
+                                                   end = rows[i].end();
+                 ij != end; ++ij)
+                colmax[ij->first] = std::max(colmax[ij->first],
+                                             Real(ij->second));
+
+        size_t dropped = 0;
+
+        #pragma omp parallel for reduction(+:dropped)
         for (i=0; i<n; i++) {
-            // Loop over only those a(i,k) and b(k,j) that are actually stored.
-            row_type const &ai = a.rows[i];
-            row_type       &ri = r.rows[i];
-            for (row_type::const_iterator aik = ai.begin(), ai_end = ai.end();
-                 aik != ai_end; ++aik) {
-                int k = aik->first;
-                row_type const &bk = b.rows[k];
-                for (row_type::const_iterator bkj = bk.begin(), bk_end = bk.end();
-                     bkj != bk_end; ++bkj) {
-                    int j = bkj->first;
-                    ri[j] += aik->second * bkj->second;
-                }
+            std::vector<std::pair<unsigned, Real> > row;
+            for (typename row_type::const_iterator ij = rows[i].begin(),
+                                                   end = rows[i].end();
+                 ij != end; ++ij)
+                if (colmax[i] * ij->second >= threshold)
+                    row.push_back(std::make_pair(ij->first,
+                                                 Real(ij->second)));
+
+            size_t keep = fanout == 0 ? row.size()
+                                      : std::min(fanout, row.size());
+
+            std::partial_sort(row.begin(), row.begin() + keep, row.end(),
+                              GtByValue);
+            for (size_t j=0; j<keep; j++)
+                out.rows[i][row[j].first] = row[j].second;
+            dropped += rows[i].size() - keep;
+        }
+        return dropped;
+    }
+
+    /**
+     * Compute rows lo up to hi of the product of this matrix and b,
+     * storing them in r. Those rows of r must be empty (all zero).
+     * b may be a Replicated<BasicMatrix>, read from the local copy.
+     */
+    template <typename B>
+    void multiply(B const &b, BasicMatrix &r,
+                  unsigned lo, unsigned hi, WorkStats &ws) const
+    { mult(*this, b, r, lo, hi, ws); }
+
+    /**
+     * Square this matrix, storing rows lo up to hi of the result in r.
+     * Those rows of r must be empty (all zero).
+     */
+    void square(BasicMatrix &r, unsigned lo, unsigned hi,
+                WorkStats &ws) const
+    { mult(*this, *this, r, lo, hi, ws); }
+
+    void square(BasicMatrix &r, WorkStats &ws) const
+    { mult(*this, *this, r, 0, nrows(), ws); }
+
+  private:
+    void topk_row(BasicMatrix const &, unsigned, std::size_t,
+                  std::vector<Real> const &, std::vector<char> const &,
+                  std::vector<std::pair<unsigned, Real> > &,
+                  std::size_t &, std::size_t &) const;
+
+    void paths_row(BasicMatrix const &, unsigned, unsigned, std::size_t,
+                   boost::unordered_map<unsigned, Real> &,
+                   std::vector<std::pair<unsigned, Real> > &,
+                   std::size_t &) const;
+
+    static bool GtByValue(std::pair<unsigned, Real> const &x,
+                           std::pair<unsigned, Real> const &y)
+    {
+        return x.second > y.second;
+    }
+
+    /*
+     * Compute row i of a * b into ri, which must be empty, adding to
+     * flops. Sums are formed in double and rounded to W when done;
+     * specialized below for Real, which accumulates in place.
+     */
+    static void mult_row(BasicMatrix const &a, BasicMatrix const &b,
+                         unsigned i, row_type &ri, std::size_t &flops)
+    {
+        boost::unordered_map<unsigned, double> acc;
+        row_type const &ai = a.rows[i];
+        for (typename row_type::const_iterator aik = ai.begin(),
+                                               ai_end = ai.end();
+             aik != ai_end; ++aik) {
+            double x = Real(aik->second);
+            row_type const &bk = b.rows[aik->first];
+            for (typename row_type::const_iterator bkj = bk.begin(),
+                                                   bk_end = bk.end();
+                 bkj != bk_end; ++bkj)
+                acc[bkj->first] += x * Real(bkj->second);
+            flops += 2 * bk.size();     // multiply-add
+        }
+        for (boost::unordered_map<unsigned, double>::const_iterator
+                 j = acc.begin(), end = acc.end(); j != end; ++j)
+            ri[j->first] = Real(j->second);
+    }
+
+    // Rows are scheduled statically, as in localize
+    template <typename B>
+    static void mult(BasicMatrix const &a, B const &b,
+                     BasicMatrix &r, unsigned lo, unsigned hi, WorkStats &ws)
+    {
+        int l = lo, h = hi;
+        std::size_t flops = 0;
+
+        #pragma omp parallel reduction(+:flops)
+        {
+            double start = wall_time();
+            BasicMatrix const &bl = local(b);
+            int i;
+
+            #pragma omp for schedule(static) nowait
+            for (i=l; i<h; i++) {
+                mult_row(a, bl, i, r.rows[i], flops);
+                progress.rows.add();
             }
+            ws.thread_done(start);
         }
+        ws.flops += flops;
     }
 };
 
+template <>
+inline void BasicMatrix<Real>::mult_row(BasicMatrix const &a,
+                                        BasicMatrix const &b, unsigned i,
+                                        row_type &ri, std::size_t &flops)
+{
+    // Loop over only those a(i,k) and b(k,j) that are actually stored.
+    row_type const &ai = a.rows[i];
+    for (row_type::const_iterator aik = ai.begin(), ai_end = ai.end();
+         aik != ai_end; ++aik) {
+        int k = aik->first;
+        row_type const &bk = b.rows[k];
+        for (row_type::const_iterator bkj = bk.begin(), bk_end = bk.end();
+             bkj != bk_end; ++bkj) {
+            int j = bkj->first;
+            ri[j] += aik->second * bkj->second;
+        }
+        flops += 2 * bk.size();     // multiply-add
+    }
+}
+
+typedef BasicMatrix<Real> Matrix;
+
 #endif // _MATRIX_HPP
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+#ifdef HAVE_SCHED_SETAFFINITY
+#   include <sched.h>
+#endif
+
+#include "numa.hpp"
+
+Numa numa;
+
+namespace {
+    // Parse a CPU or node list such as "0-3,8-11"
+    std::vector<unsigned> parse_cpulist(std::string const &s)
+    {
+        std::vector<unsigned> cpus;
+        std::istringstream in(s);
+        std::string range;
+        while (std::getline(in, range, ',')) {
+            unsigned lo, hi;
+            int n = std::sscanf(range.c_str(), "%u-%u", &lo, &hi);
+            if (n == 1)
+                hi = lo;
+            else if (n != 2)
+                continue;
+            for (unsigned c = lo; c <= hi; c++)
+                cpus.push_back(c);
+        }
+        return cpus;
+    }
+
+    #ifdef HAVE_SCHED_SETAFFINITY
+        // CPUs the process may run on at startup; null if unknown
+        cpu_set_t const *allowed_cpus()
+        {
+            static cpu_set_t allowed;
+            static bool known = sched_getaffinity(0, sizeof(allowed),
+                                                  &allowed) == 0;
+            return known ? &allowed : 0;
+        }
+    #endif
+
+    bool usable(unsigned cpu)
+    {
+        #ifdef HAVE_SCHED_SETAFFINITY
+            cpu_set_t const *allowed = allowed_cpus();
+            return !allowed || cpu >= CPU_SETSIZE || CPU_ISSET(cpu, allowed);
+        #else
+            (void)cpu;
+            return true;
+        #endif
+    }
+}
+
+/*
+ * Read the nodes and their CPUs from sysfs. Nodes are numbered densely
+ * in the order found, skipping those without CPUs we may run on.
+ */
+Numa::Numa() : npinned(0)
+{
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string line;
+    if (std::getline(online, line)) {
+        std::vector<unsigned> nodes = parse_cpulist(line);
+        for (std::size_t n = 0; n < nodes.size(); n++) {
+            std::ostringstream path;
+            path << "/sys/devices/system/node/node" << nodes[n]
+                 << "/cpulist";
+            std::ifstream in(path.str().c_str());
+            if (!std::getline(in, line))
+                continue;
+
+            std::vector<unsigned> all = parse_cpulist(line), mine;
+            for (std::size_t c = 0; c < all.size(); c++)
+                if (usable(all[c]))
+                    mine.push_back(all[c]);
+            if (!mine.empty())
+                cpus.push_back(mine);
+        }
+    }
+
+    if (cpus.empty())
+        cpus.resize(1);     // unknown topology: one node, no CPU list
+}
+
+int Numa::pin(int threads)
+{
+    std::vector<unsigned> cpu_of, node_of;
+    for (std::size_t nd = 0; nd < cpus.size(); nd++)
+        for (std::size_t c = 0; c < cpus[nd].size(); c++) {
+            cpu_of.push_back(cpus[nd][c]);
+            node_of.push_back(nd);
+        }
+
+    #ifndef HAVE_SCHED_SETAFFINITY
+        cpu_of.clear();
+    #endif
+    if (cpu_of.empty() || threads < 1)
+        return 0;
+    unpin();
+
+    // Thread t gets the t'th of threads evenly spaced CPUs in node order
+    std::vector<unsigned> assigned(threads);
+    for (int t = 0; t < threads; t++)
+        assigned[t] = std::size_t(t) * cpu_of.size() / threads;
+
+    int pinned = 0;
+    #ifdef HAVE_SCHED_SETAFFINITY
+        #pragma omp parallel num_threads(threads) reduction(+:pinned)
+        {
+            int t = 0;
+            #ifdef _OPENMP
+                t = omp_get_thread_num();
+            #endif
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu_of[assigned[t]], &set);
+            if (sched_setaffinity(0, sizeof(set), &set) == 0)
+                pinned++;
+        }
+    #endif
+    npinned = threads;
+
+    if (pinned < threads)
+        return pinned;      // some failed; don't rely on node()
+
+    thread_node.resize(threads);
+    for (int t = 0; t < threads; t++)
+        thread_node[t] = node_of[assigned[t]];
+    return pinned;
+}
+
+void Numa::unpin()
+{
+    #ifdef HAVE_SCHED_SETAFFINITY
+        cpu_set_t const *allowed = allowed_cpus();
+        if (npinned > 0 && allowed) {
+            #pragma omp parallel num_threads(npinned)
+            sched_setaffinity(0, sizeof(*allowed), allowed);
+        }
+    #endif
+    npinned = 0;
+    thread_node.clear();
+}
+
+unsigned Numa::node(int t) const
+{
+    if (t < 0) {
+        t = 0;
+        #ifdef _OPENMP
+            t = omp_get_thread_num();
+        #endif
+    }
+    return std::size_t(t) < thread_node.size() ? thread_node[t] : 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef NUMA_HPP
+#define NUMA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+/**
+ * NUMA topology and placement of OpenMP threads.
+ *
+ * The topology is read from /sys/devices/system/node; without it, all
+ * CPUs are taken to be on one node. After pin(), each OpenMP thread runs
+ * on a CPU of its own and node() tells on which node. Threads are
+ * assigned to nodes in contiguous ranges, so that under static scheduling
+ * each node handles a contiguous range of rows.
+ *
+ * Memory is placed by first touch: Linux allocates a page on the node of
+ * the thread that first writes to it.
+ */
+class Numa {
+    std::vector<std::vector<unsigned> > cpus;   // usable CPUs per node
+    std::vector<unsigned> thread_node;          // empty if not pinned
+    int npinned;                                // threads pin() moved
+
+  public:
+    Numa();
+
+    std::size_t nodes() const { return cpus.size(); }
+    bool pinned() const { return !thread_node.empty(); }
+
+    /**
+     * Pin the first threads OpenMP threads to CPUs, spread evenly over
+     * the nodes.
+     * Returns the number of threads pinned.
+     */
+    int pin(int threads);
+
+    /**
+     * Allow the threads pinned by pin() to run on all the CPUs that the
+     * process was allowed at startup.
+     */
+    void unpin();
+
+    /**
+     * Node of OpenMP thread t (of the calling thread if t < 0); 0 if
+     * threads are not pinned.
+     */
+    unsigned node(int t = -1) const;
+};
+
+extern Numa numa;
+
+/**
+ * Read-only object M (a matrix) with, on request, a copy on each NUMA
+ * node; local() returns the one on the calling thread's node.
+ */
+template <typename M>
+class Replicated {
+    M const *original;
+    std::vector<M const *> copies;      // per node; empty if none
+
+    Replicated(Replicated const &);
+    Replicated &operator=(Replicated const &);
+
+  public:
+    explicit Replicated(M const *m) : original(m) { }
+
+    ~Replicated()
+    {
+        for (std::size_t i = 0; i < copies.size(); i++)
+            if (copies[i] != original)
+                delete copies[i];
+    }
+
+    /**
+     * Copy the original to each node but that of the master thread. Each
+     * copy is made by a thread on its node. Returns the number of copies
+     * in use, including the original.
+     */
+    std::size_t replicate()
+    {
+        if (!numa.pinned() || numa.nodes() < 2)
+            return 1;
+
+        copies.assign(numa.nodes(), 0);
+        copies[numa.node(0)] = original;
+
+        #pragma omp parallel
+        {
+            int t = 0;
+            #ifdef _OPENMP
+                t = omp_get_thread_num();
+            #endif
+            unsigned nd = numa.node(t);
+
+            // The lowest-numbered thread on each node makes its copy
+            bool first = true;
+            for (int u = 0; u < t; u++)
+                if (numa.node(u) == nd)
+                    first = false;
+            if (first && copies[nd] == 0)
+                copies[nd] = new M(*original);
+        }
+
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < copies.size(); i++)
+            if (copies[i] == 0)
+                copies[i] = original;   // node without threads
+            else
+                n++;
+        return n;
+    }
+
+    M const &local() const
+    {
+        return copies.empty() ? *original : *copies[numa.node()];
+    }
+};
+
+/**
+ * Allocator that leaves new elements uninitialized, so that resizing a
+ * vector doesn't touch its memory: pages are placed by the threads that
+ * first fill them. Only for trivially copyable types, which must be
+ * assigned before they are read.
+ */
+template <typename T>
+struct FirstTouchAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind { typedef FirstTouchAllocator<U> other; };
+
+    FirstTouchAllocator() { }
+
+    template <typename U>
+    FirstTouchAllocator(FirstTouchAllocator<U> const &) { }
+
+    template <typename U>
+    void construct(U *) { }
+
+    template <typename U, typename... Args>
+    void construct(U *p, Args &&... args)
+    {
+        ::new(static_cast<void *>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+/*
+ * The local copy of a matrix operand, whether replicated or not.
+ */
+template <typename M>
+inline M const &local(M const &m) { return m; }
+
+template <typename M>
+inline M const &local(Replicated<M> const &m) { return m.local(); }
+
+#endif  // NUMA_HPP
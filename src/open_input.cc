@@ -11,12 +11,35 @@
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filter/bzip2.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/operations.hpp>
 #include <fstream>
 
 #include "wikiassoc.hpp"
 
+#include "progress.hpp"
+
 namespace io = boost::iostreams;
 
+/*
+ * Pass-through filter that adds the number of bytes read to a progress
+ * counter. Sees whole buffers, not single characters, so is cheap.
+ */
+class CountingFilter : public io::multichar_input_filter {
+    Progress::Counter *count;
+
+  public:
+    CountingFilter(Progress::Counter &c) : count(&c) { }
+
+    template <typename Source>
+    std::streamsize read(Source &src, char *s, std::streamsize n)
+    {
+        std::streamsize nread = io::read(src, s, n);
+        if (nread > 0)
+            count->add(nread);
+        return nread;
+    }
+};
+
 class InputStream : public io::filtering_istream {
     std::ifstream file;
 
@@ -26,17 +49,20 @@ class InputStream : public io::filtering_istream {
     {
         using boost::algorithm::iends_with;
 
+        push(CountingFilter(progress.uncompressed));
         if (iends_with(path, ".gz"))
             push(io::gzip_decompressor());
         else if (iends_with(path, ".bz2"))
             push(io::bzip2_decompressor());
+        push(CountingFilter(progress.compressed));
         push(file);
     }
 };
 
 /**
  * Open input file, return istream* with gzip or bzip2 decompressor
- * stacked in if necessary.
+ * stacked in if necessary. Bytes read are counted before and after
+ * decompression in progress.
  */
 std::istream *open_input(char const *path)
 {
@@ -9,8 +9,6 @@
 
 #include <boost/iterator/filter_iterator.hpp>
 #include <algorithm>
-#include <iostream>
-#include <sstream>
 #include <utility>
 #include <vector>
 
@@ -18,13 +16,18 @@
 
 #include "article.hpp"
 #include "matrix.hpp"
+#include "progress.hpp"
 
 namespace {
-    /* Reverse comparison by second member */
+    /*
+     * Reverse comparison by second member; ties are broken by the first
+     * member so that output doesn't depend on hash table order.
+     */
     template <typename T, typename U>
     inline bool GtBySecond(std::pair<T,U> const &x, std::pair<T,U> const &y)
     {
-        return x.second > y.second;
+        return x.second > y.second
+            || (x.second == y.second && x.first < y.first);
     }
 
     class IncludeFilter
@@ -45,47 +48,59 @@ namespace {
 }
 
 /**
- * Write at most n_out term associations, sorted by relevance (pf-ibf score)
- * to std::cout. Skips over terms that match the RE exclude.
+ * Pass at most n_out term associations, sorted by relevance (pf-ibf score)
+ * to emit, for rows lo up to hi. Skips over terms that match the RE
+ * exclude.
  *
- * If weights == true, output scores as well.
+ * Per-thread busy time is recorded in ws.
  */
-void Matrix::output(std::size_t n_out, bool weights,
-                    boost::regex const &exclude,
-                    ArticleSet const &articles) const
+template <typename W>
+void BasicMatrix<W>::output(std::size_t n_out, ResultCallback const &emit,
+                            boost::regex const &exclude,
+                            ArticleSet const &articles,
+                            unsigned lo, unsigned hi, WorkStats &ws) const
 {
-    int i, n = nrows();
+    int l = lo, h = hi;
     IncludeFilter include(exclude, articles);
 
-    #pragma omp parallel for
-    for (i=0; i<n; i++) {
-        if (!include(i))
-            continue;
-
-        std::vector<std::pair<unsigned, Real> > related(n_out);
-
-        // Filter by the RE first, so we still get n_out items if possible
-        boost::filter_iterator<IncludeFilter, row_type::const_iterator>
-            begin(include, rows[i].begin(), rows[i].end()),
-            end(  include, rows[i].end(),   rows[i].end());
-
-        related.erase(
-                std::partial_sort_copy(begin, end,
-                                       related.begin(), related.end(),
-                                       GtBySecond<unsigned, Real>),
-                related.end()
-            );
-
-        std::stringstream s;
-        s << articles[i].title << "\n";
-        for (size_t j=0; j<related.size(); j++) {
-            s << "    " << articles[related[j].first].title;
-            if (weights)
-                s << " " << related[j].second;
-            s << "\n";
+    #pragma omp parallel
+    {
+        double start = wall_time();
+        int i;
+
+        #pragma omp for nowait
+        for (i=l; i<h; i++) {
+            progress.rows.add();
+            if (!include(i))
+                continue;
+
+            std::vector<std::pair<unsigned, Real> > related(n_out);
+
+            // Filter by the RE first, so we still get n_out items if possible
+            typedef typename row_type::const_iterator iterator;
+            boost::filter_iterator<IncludeFilter, iterator>
+                begin(include, rows[i].begin(), rows[i].end()),
+                end(  include, rows[i].end(),   rows[i].end());
+
+            related.erase(
+                    std::partial_sort_copy(begin, end,
+                                           related.begin(), related.end(),
+                                           GtBySecond<unsigned, Real>),
+                    related.end()
+                );
+
+            emit(i, related);
         }
 
-        #pragma omp critical
-        std::cout << s.rdbuf();
+        ws.thread_done(start);
     }
 }
+
+#define INSTANTIATE(W) \
+    template void BasicMatrix<W>::output(std::size_t, \
+                                         ResultCallback const &, \
+                                         boost::regex const &, \
+                                         ArticleSet const &, unsigned, \
+                                         unsigned, WorkStats &) const;
+FOR_EACH_WEIGHT(INSTANTIATE)
+#undef INSTANTIATE
@@ -13,6 +13,7 @@
 #include <boost/spirit/include/classic_assign_key_actor.hpp>
 #include <boost/spirit/include/support_istream_iterator.hpp>
 #include <istream>
+#include <sstream>
 #include <string>
 #include <utility>
 
@@ -20,6 +21,7 @@
 
 #include "article.hpp"
 #include "matrix.hpp"
+#include "progress.hpp"
 
 namespace spc = BOOST_SPIRIT_CLASSIC_NS;
 
@@ -27,46 +29,73 @@ namespace spc = BOOST_SPIRIT_CLASSIC_NS;
  * Semantic action functor that stores the from_id/to_id pair in the
  * supplied containers, if both pages belong to the Wikipedia main
  * namespace and the page being linked to is in titles
- * (is not a 'red link')
+ * (is not a 'red link'). Links to redirect pages are stored as links
+ * to the redirect target.
  */
 struct AssignLinkActor
 {
     ArticleSet &articles;
+    RedirectSet const &redirects;
     Matrix &mat;
     std::vector<unsigned> &incoming;
     unsigned &cur_from, &cur_ns;
-
-    AssignLinkActor(unsigned &from, unsigned &ns, ArticleSet &arts, Matrix &m,
-                    std::vector<unsigned> &incoming_)
-      : articles(arts), cur_from(from), cur_ns(ns), mat(m),
-        incoming(incoming_)
+    std::size_t &nlinks, &nredirected;
+
+    AssignLinkActor(unsigned &from, unsigned &ns, ArticleSet &arts,
+                    RedirectSet const &redirs, Matrix &m,
+                    std::vector<unsigned> &incoming_,
+                    std::size_t &nlinks_, std::size_t &nredirected_)
+      : articles(arts), redirects(redirs), mat(m), incoming(incoming_),
+        cur_from(from), cur_ns(ns), nlinks(nlinks_), nredirected(nredirected_)
     {
     }
 
     template <typename Iter>
     void operator()(Iter s, Iter end) const
     {
+        progress.tuples.add();
         if (cur_ns != WIKIPEDIA_MAIN_NS)
             return;
 
         std::string title(s,end);
         sql_unescape(title);
 
-        typedef ArticleSet::index<by_title>::type ArticleByTitle;
-        ArticleByTitle::iterator to = articles.get<by_title>().find(title);
-        if (to == articles.get<by_title>().end())
-            return;
-
         typedef ArticleSet::index<by_db_id>::type ArticleById;
         ArticleById::iterator from = articles.get<by_db_id>().find(cur_from);
         if (from == articles.get<by_db_id>().end())
             return;
 
-        unsigned from_idx = articles.project<0>(from) - articles.begin(),
-                 to_idx   = articles.project<0>(to)   - articles.begin();
+        unsigned to_idx;
+        bool redirected = false;
 
-        mat(from_idx, to_idx) = 1.;
+        typedef ArticleSet::index<by_title>::type ArticleByTitle;
+        ArticleByTitle::iterator to = articles.get<by_title>().find(title);
+        if (to != articles.get<by_title>().end())
+            to_idx = articles.project<0>(to) - articles.begin();
+        else {
+            typedef RedirectSet::index<by_title>::type RedirectByTitle;
+            RedirectByTitle::iterator rd = redirects.get<by_title>().find(title);
+            if (rd == redirects.get<by_title>().end()
+             || rd->target_idx == UINT_MAX)
+                return;
+            to_idx = rd->target_idx;
+            redirected = true;
+        }
+
+        unsigned from_idx = articles.project<0>(from) - articles.begin();
+
+        // An article may link to both a redirect and its target;
+        // count such links only once.
+        Real &link = mat(from_idx, to_idx);
+        if (link != 0.)
+            return;
+        link = 1.;
         incoming[to_idx] += 1;
+
+        nlinks++;
+        progress.links.add();
+        if (redirected)
+            nredirected++;
     }
 };
 
@@ -82,9 +111,11 @@ struct InsertLink : public spc::grammar<InsertLink>
     AssignLinkActor assign_link;
     unsigned cur_from, cur_ns;
 
-    InsertLink(ArticleSet &articles, Matrix &mat,
-               std::vector<unsigned> &incoming)
-      : assign_link(cur_from, cur_ns, articles, mat, incoming)
+    InsertLink(ArticleSet &articles, RedirectSet const &redirects,
+               Matrix &mat, std::vector<unsigned> &incoming,
+               std::size_t &nlinks, std::size_t &nredirected)
+      : assign_link(cur_from, cur_ns, articles, redirects, mat, incoming,
+                    nlinks, nredirected)
     {
     }
 
@@ -154,7 +185,8 @@ struct InsertLink : public spc::grammar<InsertLink>
     };
 };
 
-void parse_linktable(std::istream &input, ArticleSet &articles, Matrix &mat,
+void parse_linktable(std::istream &input, ArticleSet &articles,
+                     RedirectSet const &redirects, Matrix &mat,
                      std::vector<unsigned> &incoming)
 {
     namespace spirit = boost::spirit;
@@ -162,7 +194,17 @@ void parse_linktable(std::istream &input, ArticleSet &articles, Matrix &mat,
     input.unsetf(std::ios::skipws);
     logmsg("parsing link table");
 
+    std::size_t nlinks = 0, nredirected = 0;
+
     spc::parse_info<spirit::istream_iterator> info;
     info = parse(spirit::istream_iterator(input), spirit::istream_iterator(),
-                 InsertLink(articles, mat, incoming), spc::space_p);
+                 InsertLink(articles, redirects, mat, incoming,
+                            nlinks, nredirected),
+                 spc::space_p);
+
+    std::ostringstream msg;
+    msg << "read " << nlinks << " links";
+    if (!redirects.empty())
+        msg << ", " << nredirected << " through redirects";
+    logmsg(msg.str());
 }
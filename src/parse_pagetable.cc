@@ -11,56 +11,135 @@
 #include <boost/spirit/include/classic_confix.hpp>
 #include <boost/spirit/include/classic_assign_actor.hpp>
 #include <boost/spirit/include/classic_assign_key_actor.hpp>
+#include <boost/spirit/include/classic_increment_actor.hpp>
 #include <boost/spirit/include/support_istream_iterator.hpp>
 #include <istream>
+#include <sstream>
 #include <string>
 #include <utility>
 
 #include "wikiassoc.hpp"
 
 #include "article.hpp"
+#include "progress.hpp"
 
 namespace spc = BOOST_SPIRIT_CLASSIC_NS;
 
 /*
  * Semantic action functor that stores the title/id pair
  * if the page belongs to the Wikipedia main namespace.
+ *
+ * If redirects is non-null, redirect pages are stored there instead of
+ * in articles.
  */
 struct AssignTitleActor
 {
     ArticleSet &articles;
-    unsigned &cur_id, &cur_ns;
+    RedirectSet *redirects;
+    unsigned &cur_id, &cur_ns, &cur_redirect;
+    std::string &cur_title;
 
-    AssignTitleActor(ArticleSet &arts, unsigned &id, unsigned &ns)
-      : articles(arts), cur_id(id), cur_ns(ns)
+    AssignTitleActor(ArticleSet &arts, RedirectSet *redirs, unsigned &id,
+                     unsigned &ns, unsigned &redirect, std::string &title)
+      : articles(arts), redirects(redirs), cur_id(id), cur_ns(ns),
+        cur_redirect(redirect), cur_title(title)
     {
     }
 
     template <typename Iter>
-    void operator()(Iter s, Iter end) const
+    void operator()(Iter, Iter) const
     {
+        progress.tuples.add();
         if (cur_ns == WIKIPEDIA_MAIN_NS) {
-            std::string title(s,end);
+            std::string title(cur_title);
             sql_unescape(title);
-            articles.push_back(Article(title, cur_id));
+            if (redirects && cur_redirect)
+                redirects->insert(Redirect(title, cur_id));
+            else
+                articles.push_back(Article(title, cur_id));
         }
     }
 };
 
+/*
+ * Semantic action functor for the columns of the page table, as listed in
+ * its CREATE TABLE statement: notes the position of page_is_redirect.
+ */
+struct ColumnActor
+{
+    unsigned &ncolumns, &redirect_column;
+
+    ColumnActor(unsigned &n, unsigned &redirect)
+      : ncolumns(n), redirect_column(redirect)
+    {
+    }
+
+    template <typename Iter>
+    void operator()(Iter s, Iter end) const
+    {
+        if (std::string(s, end) == "page_is_redirect")
+            redirect_column = ncolumns;
+        ncolumns++;
+    }
+};
+
+/*
+ * Semantic action functor for the fields of a tuple after the title:
+ * reads page_is_redirect from the one in redirect_column. The title itself
+ * (column 2) starts the count.
+ */
+struct FieldActor
+{
+    unsigned &cur_field, &cur_redirect;
+    unsigned const &redirect_column;
+    bool title;
+
+    FieldActor(unsigned &field, unsigned &redirect, unsigned const &column,
+               bool title_)
+      : cur_field(field), cur_redirect(redirect), redirect_column(column),
+        title(title_)
+    {
+    }
+
+    template <typename Iter>
+    void operator()(Iter s, Iter end) const
+    {
+        if (title) {
+            cur_field = 3;
+            cur_redirect = 0;
+        } else if (cur_field++ == redirect_column)
+            cur_redirect = std::string(s, end) == "1";
+    }
+};
+
 /**
  * Grammar for SQL INSERT statement in the MediaWiki `page` table
  *
- * This parser is specific to the MySQL dumps from MediaWiki 1.15,
- * as used by Wikipedia and documented at
- * http://www.mediawiki.org/wiki/Manual:Page_table
+ * Only page_id, page_namespace and page_title, which come first in all
+ * versions of the table, and page_is_redirect are used. The position of
+ * the latter is taken from the CREATE TABLE statement in the dump; if
+ * there is none, it is that of the MySQL dumps from MediaWiki 1.15, as
+ * documented at http://www.mediawiki.org/wiki/Manual:Page_table
+ * (after page_restrictions and page_counter).
  */
 struct InsertPage : public spc::grammar<InsertPage>
 {
     AssignTitleActor assign_title;
-    unsigned cur_id, cur_ns;
+    ColumnActor assign_column;
+    FieldActor start_fields, assign_field;
+    unsigned cur_id, cur_ns, cur_redirect, cur_field;
+    std::string cur_title;
+    unsigned ncolumns, redirect_column;
+    std::size_t &nbad;      // INSERT statements not parsed
 
-    InsertPage(ArticleSet &articles)
-      : assign_title(articles, cur_id, cur_ns)
+    InsertPage(ArticleSet &articles, RedirectSet *redirects,
+               std::size_t &nbad_)
+      : assign_title(articles, redirects, cur_id, cur_ns, cur_redirect,
+                     cur_title),
+        assign_column(ncolumns, redirect_column),
+        start_fields(cur_field, cur_redirect, redirect_column, true),
+        assign_field(cur_field, cur_redirect, redirect_column, false),
+        ncolumns(0), redirect_column(5), nbad(nbad_)
     {
     }
 
@@ -72,7 +151,12 @@ struct InsertPage : public spc::grammar<InsertPage>
 
             // note: short-circuited |
             strt
-                =   *(insert_stmt | comment | other_stmt)
+                =   *(  insert_stmt
+                     |  bad_insert_stmt
+                     |  create_stmt
+                     |  comment
+                     |  other_stmt
+                     )
                 ;
 
             comment
@@ -90,22 +174,70 @@ struct InsertPage : public spc::grammar<InsertPage>
                  >> values >> ch_p(';')
                 ;
 
+            bad_insert_stmt
+                =   (   str_p("INSERT") >> str_p("INTO") >> str_p("`page`")
+                     >> *(anychar_p - ';') >> ';'
+                    )[increment_a(self.nbad)]
+                ;
+
+            create_stmt
+                =   str_p("CREATE") >> str_p("TABLE") >> str_p("`page`")
+                 >> ch_p('(')
+                 >> (column_def | key_def) % ch_p(',')
+                 >> ch_p(')') >> *(anychar_p - ';') >> ';'
+                ;
+
+            column_def
+                =   lexeme_d['`' >> (+(anychar_p - '`'))[self.assign_column]
+                             >> '`']
+                 >> key_def
+                ;
+
+            // Type, attributes or key; may hold commas in parentheses or
+            // quotes
+            key_def
+                =   *(  parenthesized
+                     |  quoted_field
+                     |  (anychar_p - ',' - '(' - ')' - '\'')
+                     )
+                ;
+
+            parenthesized
+                =   ch_p('(')
+                 >> *(  parenthesized
+                     |  quoted_field
+                     |  (anychar_p - '(' - ')' - '\'')
+                     )
+                 >> ch_p(')')
+                ;
+
             values
                 =   +value % ch_p(',');
 
             // XXX
             // The const_cast's are ugly; maybe declare the
             // assignment actors in the grammar class?
+            // Fields after the title are counted from 3, for
+            // page_is_redirect.
             value
-                =   ch_p('(')
-                 >> uint_p[assign_a(const_cast<unsigned &>(self.cur_id))]
-                 >> ch_p(',')
-                 >> uint_p[assign_a(const_cast<unsigned &>(self.cur_ns))]
-                 >> ch_p(',')
-                 >> quoted_string
-                 >> ch_p(',')
-                 >> *(anychar_p - ')')
-                 >> ch_p(')')
+                =   (   ch_p('(')
+                     >> uint_p[assign_a(const_cast<unsigned &>(self.cur_id))]
+                     >> ch_p(',')
+                     >> uint_p[assign_a(const_cast<unsigned &>(self.cur_ns))]
+                     >> ch_p(',')
+                     >> quoted_string[self.start_fields]
+                     >> *(ch_p(',') >> field[self.assign_field])
+                     >> ch_p(')')
+                    )[self.assign_title]
+                ;
+
+            field
+                =   quoted_field
+                |   lexeme_d[+(anychar_p - ',' - ')' - '\'' - space_p)]
+                ;
+
+            quoted_field
+                =   lexeme_d['\'' >> *qchar >> '\'']
                 ;
 
             quoted_string
@@ -115,7 +247,8 @@ struct InsertPage : public spc::grammar<InsertPage>
                 ;
 
             quoted_text
-                =   lexeme_d[+qchar][self.assign_title]
+                =   lexeme_d[+qchar][assign_a(
+                        const_cast<std::string &>(self.cur_title))]
                 ;
 
             qchar
@@ -124,7 +257,9 @@ struct InsertPage : public spc::grammar<InsertPage>
                 ;
         }
 
-        spc::rule<Scanner> strt, insert_stmt, other_stmt, values, value,
+        spc::rule<Scanner> strt, insert_stmt, bad_insert_stmt, create_stmt,
+                           column_def, key_def, parenthesized, other_stmt,
+                           values, value, field, quoted_field,
                            quoted_string, quoted_text, qchar, comment;
 
         spc::rule<Scanner> const &start() const
@@ -132,14 +267,28 @@ struct InsertPage : public spc::grammar<InsertPage>
     };
 };
 
-void parse_pagetable(std::istream &input, ArticleSet &articles)
+void parse_pagetable(std::istream &input, ArticleSet &articles,
+                     RedirectSet *redirects)
 {
     namespace spirit = boost::spirit;
 
     input.unsetf(std::ios::skipws);
     logmsg("parsing page table");
 
+    std::size_t nbad = 0;
     spc::parse_info<spirit::istream_iterator> info;
     info = parse(spirit::istream_iterator(input), spirit::istream_iterator(),
-                 InsertPage(articles), spc::space_p);
+                 InsertPage(articles, redirects, nbad), spc::space_p);
+
+    std::ostringstream msg;
+    msg << "read " << articles.size() << " articles";
+    if (redirects)
+        msg << ", " << redirects->size() << " redirects";
+    logmsg(msg.str());
+    if (nbad > 0) {
+        msg.str("");
+        msg << "warning: could not parse " << nbad
+            << " INSERT statements in page table";
+        logmsg(msg.str());
+    }
 }
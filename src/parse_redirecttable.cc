@@ -0,0 +1,198 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <boost/spirit/include/classic_core.hpp>
+#include <boost/spirit/include/classic_confix.hpp>
+#include <boost/spirit/include/classic_assign_actor.hpp>
+#include <boost/spirit/include/support_istream_iterator.hpp>
+#include <istream>
+#include <sstream>
+#include <string>
+
+#include "wikiassoc.hpp"
+
+#include "article.hpp"
+#include "progress.hpp"
+
+namespace spc = BOOST_SPIRIT_CLASSIC_NS;
+
+namespace {
+    // Maximum length of a chain of double redirects that we follow.
+    // MediaWiki itself follows only one.
+    const unsigned MAX_REDIRECT_HOPS = 4;
+}
+
+/*
+ * Semantic action functor that stores the target title of a redirect,
+ * if the redirect was read from the page table and points into the
+ * Wikipedia main namespace.
+ */
+struct AssignTargetActor
+{
+    RedirectSet &redirects;
+    unsigned &cur_from, &cur_ns;
+
+    AssignTargetActor(RedirectSet &redirs, unsigned &from, unsigned &ns)
+      : redirects(redirs), cur_from(from), cur_ns(ns)
+    {
+    }
+
+    template <typename Iter>
+    void operator()(Iter s, Iter end) const
+    {
+        progress.tuples.add();
+        if (cur_ns != WIKIPEDIA_MAIN_NS)
+            return;
+
+        typedef RedirectSet::index<by_db_id>::type RedirectById;
+        RedirectById::iterator rd = redirects.get<by_db_id>().find(cur_from);
+        if (rd == redirects.get<by_db_id>().end())
+            return;
+
+        rd->target.assign(s, end);
+        sql_unescape(rd->target);
+    }
+};
+
+/*
+ * Grammar for SQL INSERT statement in the MediaWiki `redirect` table
+ *
+ * This grammar is specific to the MySQL dumps from MediaWiki 1.15,
+ * as used by Wikipedia and documented at
+ * http://www.mediawiki.org/wiki/Manual:Redirect_table
+ */
+struct InsertRedirect : public spc::grammar<InsertRedirect>
+{
+    AssignTargetActor assign_target;
+    unsigned cur_from, cur_ns;
+
+    InsertRedirect(RedirectSet &redirects)
+      : assign_target(redirects, cur_from, cur_ns)
+    {
+    }
+
+    template <typename Scanner>
+    struct definition {
+        definition(InsertRedirect const &self)
+        {
+            using namespace spc;
+
+            // note: short-circuited |
+            strt
+                =   *(insert_stmt | comment | other_stmt)
+                ;
+
+            comment
+                =   comment_p("--") || comment_p("/*", "*/")
+               ;
+
+            other_stmt
+                =   *(anychar_p - ';')
+                 >> ';'
+                ;
+
+            insert_stmt
+                =   str_p("INSERT") >> str_p("INTO")
+                 >> str_p("`redirect`") >> str_p("VALUES")
+                 >> values >> ch_p(';')
+                ;
+
+            values
+                =   +value % ch_p(',');
+
+            // Skips rd_interwiki and rd_fragment
+            value
+                =   ch_p('(')
+                 >> uint_p[assign_a(const_cast<unsigned &>(self.cur_from))]
+                 >> ch_p(',')
+                 >> uint_p[assign_a(const_cast<unsigned &>(self.cur_ns))]
+                 >> ch_p(',')
+                 >> quoted_string
+                 >> *(anychar_p - ')')
+                 >> ch_p(')')
+                ;
+
+            quoted_string
+                =   '\''
+                 >> quoted_text
+                 >> '\''
+                ;
+
+            quoted_text
+                =   lexeme_d[+qchar][self.assign_target]
+                ;
+
+            qchar
+                =   (anychar_p - '\\' - '\'')
+                |   ('\\' >> anychar_p)
+                ;
+        }
+
+        spc::rule<Scanner> strt, insert_stmt, other_stmt, values, value,
+                           quoted_string, quoted_text, qchar, comment;
+
+        spc::rule<Scanner> const &start() const
+        { return strt; }
+    };
+};
+
+/*
+ * Set target_idx for each redirect whose target is in articles,
+ * following double redirects up to MAX_REDIRECT_HOPS.
+ * Returns the number of redirects resolved.
+ */
+static std::size_t resolve(ArticleSet const &articles, RedirectSet &redirects)
+{
+    typedef ArticleSet::index<by_title>::type ArticleByTitle;
+    typedef RedirectSet::index<by_title>::type RedirectByTitle;
+
+    ArticleByTitle const &art_by_title = articles.get<by_title>();
+    RedirectByTitle const &rd_by_title = redirects.get<by_title>();
+    std::size_t nresolved = 0;
+
+    for (RedirectSet::iterator rd = redirects.begin(), end = redirects.end();
+         rd != end; ++rd) {
+        std::string const *target = &rd->target;
+
+        for (unsigned hops = 0; hops < MAX_REDIRECT_HOPS; hops++) {
+            ArticleByTitle::iterator art = art_by_title.find(*target);
+            if (art != art_by_title.end()) {
+                rd->target_idx = articles.project<0>(art) - articles.begin();
+                nresolved++;
+                break;
+            }
+
+            RedirectByTitle::iterator next = rd_by_title.find(*target);
+            if (next == rd_by_title.end())
+                break;
+            target = &next->target;
+        }
+    }
+    return nresolved;
+}
+
+void parse_redirecttable(std::istream &input, ArticleSet const &articles,
+                         RedirectSet &redirects)
+{
+    namespace spirit = boost::spirit;
+
+    input.unsetf(std::ios::skipws);
+    logmsg("parsing redirect table");
+
+    spc::parse_info<spirit::istream_iterator> info;
+    info = parse(spirit::istream_iterator(input), spirit::istream_iterator(),
+                 InsertRedirect(redirects), spc::space_p);
+
+    std::size_t nresolved = resolve(articles, redirects);
+
+    std::ostringstream msg;
+    msg << "resolved " << nresolved << " of " << redirects.size()
+        << " redirects";
+    logmsg(msg.str());
+}
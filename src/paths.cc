@@ -0,0 +1,186 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * pf-ibf for paths longer than two links, by frontier expansion.
+ *
+ * For path length L, the unnormalized score of j for article i is
+ *
+ *     sum_{l=1}^{L} (A^l)(i,j)
+ *
+ * which is infeasible to compute as a matrix power for L > 2. Instead,
+ * each row is expanded one hop at a time: the frontier after l hops holds
+ * the weights (A^l)(i,k) of the articles k reached, and the next frontier
+ * is the current one times the link matrix. The first two hops are exact
+ * (they give the same scores as the length 2 computation); before each
+ * later hop, the frontier is cut to its width heaviest articles, so that
+ * the work per hop and the memory per row are bounded by width times the
+ * largest number of links out of an article.
+ */
+
+#include <boost/unordered_map.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "wikiassoc.hpp"
+
+#include "article.hpp"
+#include "ibf.hpp"
+#include "matrix.hpp"
+#include "progress.hpp"
+
+namespace {
+    typedef std::pair<unsigned, Real> Entry;
+    typedef boost::unordered_map<unsigned, Real> Scores;
+
+    // Same order as used by Matrix::output
+    inline bool GtBySecond(Entry const &x, Entry const &y)
+    {
+        return x.second > y.second
+            || (x.second == y.second && x.first < y.first);
+    }
+
+    typedef Real (*Normalization)(unsigned, Real const &);
+
+    Normalization normalization(unsigned path_length)
+    {
+        switch (path_length) {
+          case 2: return normalize<2>;
+          case 3: return normalize<3>;
+          case 4: return normalize<4>;
+          case 5: return normalize<5>;
+          case 6: return normalize<6>;
+          default:
+            throw std::invalid_argument("unsupported path length");
+        }
+    }
+
+    // Keep the width heaviest entries of frontier (all if width == 0)
+    void cut(std::vector<Entry> &frontier, std::size_t width)
+    {
+        if (width == 0 || frontier.size() <= width)
+            return;
+        std::nth_element(frontier.begin(), frontier.begin() + width - 1,
+                         frontier.end(), GtBySecond);
+        frontier.resize(width);
+    }
+}
+
+/*
+ * Compute the unnormalized pf-ibf scores of row i for paths of up to
+ * length links into score, following paths through b after the first
+ * link. frontier is scratch space.
+ */
+template <typename W>
+void BasicMatrix<W>::paths_row(BasicMatrix const &b, unsigned i,
+                               unsigned length, std::size_t width,
+                               Scores &score,
+                               std::vector<Entry> &frontier,
+                               std::size_t &flops) const
+{
+    score.clear();
+    frontier.assign(rows[i].begin(), rows[i].end());
+    for (std::size_t f = 0; f < frontier.size(); f++)
+        score[frontier[f].first] += frontier[f].second;
+
+    Scores next;
+    for (unsigned hop = 2; hop <= length; hop++) {
+        if (hop > 2)
+            cut(frontier, width);
+
+        next.clear();
+        for (std::size_t f = 0; f < frontier.size(); f++) {
+            row_type const &bk = b.rows[frontier[f].first];
+            Real w = frontier[f].second;
+            for (typename row_type::const_iterator kj = bk.begin(),
+                                                   end = bk.end();
+                 kj != end; ++kj)
+                next[kj->first] += w * kj->second;
+            flops += 2 * bk.size();
+        }
+
+        frontier.assign(next.begin(), next.end());
+        for (std::size_t f = 0; f < frontier.size(); f++)
+            score[frontier[f].first] += frontier[f].second;
+    }
+}
+
+/**
+ * Pass at most n_out term associations per article to emit, like
+ * Matrix::output, for pf-ibf over paths of up to length links. Paths are
+ * followed through b after the first link; before each hop after the
+ * second, only the width articles with the heaviest paths are expanded
+ * (all if width == 0).
+ *
+ * Flops are recorded in ws.
+ */
+template <typename W>
+void BasicMatrix<W>::output_paths(BasicMatrix const &b, unsigned length,
+                                  std::size_t width, std::size_t n_out,
+                                  ResultCallback const &emit,
+                                  boost::regex const &exclude,
+                                  ArticleSet const &articles,
+                                  WorkStats &ws) const
+{
+    Normalization norm = normalization(length);
+    int i, n = nrows();
+
+    std::vector<char> include(n);
+    #pragma omp parallel for
+    for (i=0; i<n; i++)
+        include[i] = !boost::regex_match(articles[i].title, exclude);
+
+    std::size_t flops = 0;
+
+    #pragma omp parallel reduction(+:flops)
+    {
+        double start = wall_time();
+        Scores score;
+        std::vector<Entry> frontier, related;
+
+        #pragma omp for schedule(dynamic, 64) nowait
+        for (i=0; i<n; i++) {
+            progress.rows.add();
+            if (!include[i])
+                continue;
+
+            paths_row(b, i, length, width, score, frontier, flops);
+
+            related.clear();
+            for (Scores::const_iterator ij = score.begin(), end = score.end();
+                 ij != end; ++ij)
+                if (ij->first != unsigned(i) && include[ij->first])
+                    related.push_back(Entry(ij->first,
+                                            norm(ij->first, ij->second)));
+
+            std::size_t k = std::min(n_out, related.size());
+            std::partial_sort(related.begin(), related.begin() + k,
+                              related.end(), GtBySecond);
+            related.resize(k);
+            emit(i, related);
+        }
+
+        ws.thread_done(start);
+    }
+
+    ws.flops += flops;
+}
+
+#define INSTANTIATE(W) \
+    template void BasicMatrix<W>::output_paths(BasicMatrix const &, \
+                                               unsigned, std::size_t, \
+                                               std::size_t, \
+                                               ResultCallback const &, \
+                                               boost::regex const &, \
+                                               ArticleSet const &, \
+                                               WorkStats &) const;
+FOR_EACH_WEIGHT(INSTANTIATE)
+#undef INSTANTIATE
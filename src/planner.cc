@@ -0,0 +1,190 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <ostream>
+#include <random>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "wikiassoc.hpp"
+
+#include "matrix.hpp"
+#include "planner.hpp"
+#include "stats.hpp"
+
+namespace {
+    // Below this many flops, threads cost more than they save
+    const std::size_t MIN_PARALLEL_FLOPS = 10000000;
+
+    // Fraction of the memory budget we plan to fill, leaving room for
+    // estimation error and allocator slack
+    const double BUDGET_FILL = .8;
+
+    struct MB {
+        std::size_t bytes;
+        explicit MB(std::size_t b) : bytes(b) { }
+    };
+
+    std::ostream &operator<<(std::ostream &out, MB const &mb)
+    {
+        return out << std::size_t(mb.bytes / 1e6 + .5) << " MB";
+    }
+}
+
+void Plan::print(std::ostream &out) const
+{
+    out << "rows:               " << rows << '\n'
+        << "links:              " << nnz_a << '\n'
+        << "flops:              " << flops
+        << " (at most " << max_row_flops << " per row)\n"
+        << "est. non-zeros:     " << est_nnz
+        << " (+/- " << std::floor(est_error * 1000 + .5) / 10 << "%)\n"
+        << "memory in use:      " << MB(base_bytes) << '\n';
+    if (scratch_bytes)
+        out << "thread scratch:     " << MB(scratch_bytes) << '\n';
+    out << "est. peak memory:   " << MB(est_peak_bytes) << '\n'
+        << "memory budget:      " << MB(budget_bytes) << '\n'
+        << "strategy:           ";
+    if (!feasible)
+        out << "none, does not fit in memory budget\n";
+    else if (per_row)
+        out << "row by row, result not stored\n";
+    else if (nblocks() == 1)
+        out << "in memory\n";
+    else
+        out << nblocks() << " row blocks\n";
+    out << "threads:            " << threads << '\n';
+}
+
+template <typename W>
+Plan make_plan(BasicMatrix<W> const &a, BasicMatrix<W> const &b,
+               std::size_t budget, unsigned sample_size, bool per_row,
+               int threads, std::size_t element_bytes,
+               std::size_t thread_bytes)
+{
+    Plan plan;
+    std::size_t n = a.nrows();
+
+    plan.per_row = per_row;
+    plan.rows = n;
+    plan.nnz_a = a.nnz();
+    plan.base_bytes = current_rss();
+    plan.budget_bytes = budget ? budget
+                               : plan.base_bytes + available_memory();
+
+    // Exact flop counts, and their prefix sums for sampling
+    std::vector<std::size_t> row_flops(n), cum_flops(n + 1);
+    int i, nn = n;
+
+    #pragma omp parallel for
+    for (i=0; i<nn; i++)
+        row_flops[i] = a.product_row_flops(b, i);
+
+    // Rows without flops are copies of the corresponding row of a
+    std::size_t exact_nnz = 0;
+    plan.max_row_flops = 0;
+    for (std::size_t r = 0; r < n; r++) {
+        cum_flops[r + 1] = cum_flops[r] + row_flops[r];
+        plan.max_row_flops = std::max(plan.max_row_flops, row_flops[r]);
+        if (row_flops[r] == 0)
+            exact_nnz += a.row_size(r);
+    }
+    plan.flops = cum_flops[n];
+
+    plan.threads = threads > 0 ? threads : 1;
+    #ifdef _OPENMP
+        if (threads == 0 && plan.flops >= MIN_PARALLEL_FLOPS)
+            plan.threads = omp_get_max_threads();
+    #endif
+    plan.scratch_bytes = plan.threads * thread_bytes;
+
+    // Estimate the non-zeros in the remaining rows by sampling rows with
+    // probability proportional to their flop count (Horvitz-Thompson).
+    // Heavy rows dominate both the result and the error, so they should
+    // be sampled most.
+    double ratio = 0, est_error = 0;    // non-zeros per flop
+    if (plan.flops > 0 && sample_size > 0) {
+        std::mt19937_64 rng(42);
+        std::uniform_int_distribution<std::size_t> flop(0, plan.flops - 1);
+        std::vector<unsigned> sample(sample_size);
+        for (unsigned k = 0; k < sample_size; k++)
+            sample[k] = std::upper_bound(cum_flops.begin(), cum_flops.end(),
+                                         flop(rng))
+                      - cum_flops.begin() - 1;
+
+        std::vector<unsigned> distinct(sample);
+        std::sort(distinct.begin(), distinct.end());
+        distinct.erase(std::unique(distinct.begin(), distinct.end()),
+                       distinct.end());
+
+        std::vector<std::size_t> row_nnz(distinct.size());
+        int k, nd = distinct.size();
+
+        #pragma omp parallel for schedule(dynamic)
+        for (k=0; k<nd; k++)
+            row_nnz[k] = a.product_row_nnz(b, distinct[k]);
+
+        double sum = 0, sumsq = 0;
+        for (unsigned s = 0; s < sample_size; s++) {
+            std::size_t d = std::lower_bound(distinct.begin(),
+                                             distinct.end(), sample[s])
+                          - distinct.begin();
+            double y = double(row_nnz[d]) / row_flops[sample[s]];
+            sum += y;
+            sumsq += y * y;
+        }
+        ratio = sum / sample_size;
+        double var = std::max(0., sumsq / sample_size - ratio * ratio);
+        est_error = std::sqrt(var / sample_size) / ratio;
+    }
+
+    plan.est_nnz = exact_nnz + std::size_t(ratio * plan.flops);
+    plan.est_error = plan.est_nnz ? est_error * (plan.est_nnz - exact_nnz)
+                                  / plan.est_nnz
+                                  : 0;
+    std::size_t fixed_bytes = plan.base_bytes + plan.scratch_bytes;
+    plan.est_peak_bytes = fixed_bytes
+                        + (per_row ? 0 : plan.est_nnz * element_bytes);
+
+    // Cut the rows into blocks whose estimated non-zeros fit in the
+    // budget, allowing for two standard errors of underestimation.
+    double capacity = plan.budget_bytes > fixed_bytes
+                    ? (plan.budget_bytes - fixed_bytes) * BUDGET_FILL
+                      / element_bytes / (1 + 2 * est_error)
+                    : 0;
+
+    plan.feasible = per_row || plan.budget_bytes > fixed_bytes;
+    plan.blocks.push_back(0);
+    double in_block = 0;
+    for (std::size_t r = 0; r < n && !per_row; r++) {
+        double row = row_flops[r] ? ratio * row_flops[r] : a.row_size(r);
+        if (row > capacity)
+            plan.feasible = false;
+        if (in_block + row > capacity && r > plan.blocks.back()) {
+            plan.blocks.push_back(r);
+            in_block = 0;
+        }
+        in_block += row;
+    }
+    plan.blocks.push_back(n);
+
+    return plan;
+}
+
+#define INSTANTIATE(W) \
+    template Plan make_plan(BasicMatrix<W> const &, BasicMatrix<W> const &, \
+                            std::size_t, unsigned, bool, int, \
+                            std::size_t, std::size_t);
+FOR_EACH_WEIGHT(INSTANTIATE)
+#undef INSTANTIATE
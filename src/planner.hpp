@@ -0,0 +1,70 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef PLANNER_HPP
+#define PLANNER_HPP
+
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+#include "wikiassoc.hpp"
+
+/**
+ * Execution plan for squaring the link matrix and writing output.
+ *
+ * Flop counts are exact; the number of non-zeros in the result is
+ * estimated from a sample of rows. If the result is not expected to fit
+ * in memory, rows are processed in blocks: each block is squared,
+ * combined, written and freed before the next one is started.
+ * Alternatively, the top k of each row can be computed directly
+ * (Matrix::output_topk, Matrix::output_paths), which needs no memory for
+ * the result.
+ */
+struct Plan
+{
+    std::size_t rows, nnz_a;
+    std::size_t flops, max_row_flops;
+    std::size_t est_nnz;            // non-zeros in full pf-ibf matrix
+    double est_error;               // relative standard error of est_nnz
+    std::size_t base_bytes;         // in use before squaring
+    std::size_t scratch_bytes;      // allocated by threads while squaring
+    std::size_t est_peak_bytes;     // if all rows are done at once
+    std::size_t budget_bytes;
+    int threads;
+    bool feasible;
+    bool per_row;                   // row by row instead of blocks
+
+    // Block boundaries: block b is rows blocks[b] up to blocks[b+1]
+    std::vector<unsigned> blocks;
+
+    std::size_t nblocks() const { return blocks.size() - 1; }
+
+    void print(std::ostream &) const;
+};
+
+/**
+ * Plan multiplication of a by b (which is either a or a pruned copy of a)
+ * within budget bytes of memory (0 for all memory currently available),
+ * estimating the result size from sample_size sampled rows.
+ * If per_row, plan for Matrix::output_topk or output_paths instead.
+ * Squaring uses threads threads; if 0, all OpenMP threads, or only one if
+ * there is too little work to share.
+ * The result takes element_bytes per non-zero (BYTES_PER_ELEMENT of the
+ * BasicMatrix it is stored in, which need not be the type of a) and each
+ * thread allocates thread_bytes of scratch memory
+ * (CompressedMatrix::scratch_bytes with -z; 0 otherwise).
+ */
+template <typename W>
+Plan make_plan(BasicMatrix<W> const &a, BasicMatrix<W> const &b,
+               std::size_t budget, unsigned sample_size, bool per_row,
+               int threads, std::size_t element_bytes,
+               std::size_t thread_bytes = 0);
+
+#endif  // PLANNER_HPP
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+#include "wikiassoc.hpp"
+
+#include "progress.hpp"
+#include "stats.hpp"
+
+Progress progress;
+
+namespace {
+    std::string duration(double seconds)
+    {
+        unsigned long s = static_cast<unsigned long>(seconds + .5);
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%lu:%02lu:%02lu",
+                      s / 3600, s / 60 % 60, s % 60);
+        return buf;
+    }
+}
+
+Progress::Progress()
+  : interval(0), stopping(false), total(0), unit(ROWS), started(wall_time())
+{
+}
+
+void Progress::phase(char const *name_, Unit unit_, std::size_t total_)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    compressed.reset();
+    uncompressed.reset();
+    tuples.reset();
+    links.reset();
+    rows.reset();
+
+    name    = name_;
+    unit    = unit_;
+    total   = total_;
+    started = wall_time();
+}
+
+void Progress::start(unsigned interval_)
+{
+    if (interval_ == 0 || reporter.joinable())
+        return;
+    interval = interval_;
+    stopping = false;
+    reporter = std::thread(&Progress::run, this);
+}
+
+void Progress::stop()
+{
+    if (!reporter.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    reporter.join();
+}
+
+void Progress::run()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!wakeup.wait_for(lock, std::chrono::seconds(interval),
+                            [this] { return stopping; }))
+        report();
+}
+
+/*
+ * Log one line of progress. Called with mtx held.
+ */
+void Progress::report()
+{
+    double elapsed = wall_time() - started;
+    std::size_t done = unit == BYTES ? compressed.get() : rows.get();
+
+    std::ostringstream msg;
+    msg.precision(3);
+    msg << name << ": " << duration(elapsed) << " elapsed";
+
+    if (unit == BYTES && done > 0) {
+        std::size_t plain = uncompressed.get();
+        msg << ", " << done / 1e6 << " MB read, "
+            << done / elapsed / 1e6 << " MB/s";
+        if (plain != done)
+            msg << " (" << plain / elapsed / 1e6 << " MB/s uncompressed)";
+    } else if (unit == ROWS && done > 0)
+        msg << ", " << done << " rows, "
+            << static_cast<std::size_t>(done / elapsed) << " rows/s";
+
+    if (tuples.get())
+        msg << ", " << tuples.get() << " tuples";
+    if (links.get())
+        msg << ", " << links.get() << " links";
+
+    if (total > 0 && done > 0 && done <= total) {
+        msg << ", " << 100. * done / total << "% done, ETA "
+            << duration(elapsed * (total - done) / done);
+    }
+
+    logmsg(msg.str());
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef PROGRESS_HPP
+#define PROGRESS_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * Progress counters for the running phase, and a reporter thread that
+ * periodically logs them with rates and an estimated time to completion.
+ *
+ * Counters are bumped with relaxed atomics from the hot loops; the
+ * reporter only needs approximate values, so there's no synchronization
+ * beyond that.
+ */
+class Progress
+{
+  public:
+    class Counter
+    {
+        std::atomic<std::size_t> n;
+
+      public:
+        Counter() : n(0) { }
+
+        void add(std::size_t k = 1) { n.fetch_add(k, std::memory_order_relaxed); }
+        std::size_t get() const { return n.load(std::memory_order_relaxed); }
+        void reset() { n.store(0, std::memory_order_relaxed); }
+    };
+
+    // What the total passed to phase() counts
+    enum Unit { BYTES, ROWS };
+
+    Counter compressed;     // bytes read from file
+    Counter uncompressed;   // bytes after decompression
+    Counter tuples;         // SQL tuples parsed
+    Counter links;          // links stored in the matrix
+    Counter rows;           // matrix rows completed
+
+    Progress();
+    ~Progress() { stop(); }
+
+    /**
+     * Start a new phase; resets all counters. total is the size of the
+     * input file (unit == BYTES) or the number of rows to be processed
+     * (unit == ROWS), or 0 if unknown.
+     */
+    void phase(char const *name, Unit unit, std::size_t total);
+
+    /**
+     * Start logging progress every interval seconds.
+     */
+    void start(unsigned interval);
+    void stop();
+
+  private:
+    unsigned interval;
+    std::thread reporter;
+    std::mutex mtx;             // guards everything below
+    std::condition_variable wakeup;
+    bool stopping;
+
+    std::string name;
+    std::size_t total;
+    Unit unit;
+    double started;
+
+    void run();
+    void report();
+};
+
+extern Progress progress;
+
+#endif  // PROGRESS_HPP
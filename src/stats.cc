@@ -0,0 +1,195 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <numeric>
+#include <ostream>
+#include <string>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+#include "config.h"
+#include "stats.hpp"
+
+namespace {
+    double cpu_time()
+    {
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+             + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+    }
+
+    std::size_t peak_rss()
+    {
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        return std::size_t(ru.ru_maxrss) * 1024;    // Linux reports KiB
+    }
+}
+
+// Current resident set size from /proc; 0 where that's not available
+std::size_t current_rss()
+{
+    std::ifstream statm("/proc/self/statm");
+    std::size_t total, resident;
+    if (!(statm >> total >> resident))
+        return 0;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+/*
+ * Memory available for new allocations without swapping: MemAvailable
+ * from /proc/meminfo if present, else free physical memory.
+ */
+std::size_t available_memory()
+{
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    std::size_t kb;
+    while (meminfo >> key >> kb) {
+        if (key == "MemAvailable:")
+            return kb * 1024;
+        meminfo.ignore(256, '\n');
+    }
+    return std::size_t(sysconf(_SC_AVPHYS_PAGES)) * sysconf(_SC_PAGESIZE);
+}
+
+double wall_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+std::size_t file_size(char const *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_size : 0;
+}
+
+void WorkStats::thread_done(double start)
+{
+    double elapsed = wall_time() - start;
+    std::size_t t = 0;
+    #ifdef _OPENMP
+        t = omp_get_thread_num();
+    #endif
+
+    #pragma omp critical(workstats)
+    {
+        if (thread_seconds.size() <= t)
+            thread_seconds.resize(t + 1);
+        thread_seconds[t] += elapsed;
+    }
+}
+
+double WorkStats::imbalance() const
+{
+    if (thread_seconds.empty())
+        return 1.;
+
+    double max = *std::max_element(thread_seconds.begin(),
+                                   thread_seconds.end()),
+           mean = std::accumulate(thread_seconds.begin(),
+                                  thread_seconds.end(), 0.)
+                / thread_seconds.size();
+    return mean > 0 ? max / mean : 1.;
+}
+
+void PhaseStats::count(char const *what, std::size_t n)
+{
+    for (std::size_t i = 0; i < counters.size(); i++)
+        if (counters[i].first == what) {
+            counters[i].second += n;
+            return;
+        }
+    counters.push_back(std::make_pair(std::string(what), n));
+}
+
+PhaseStats &Stats::begin(char const *name)
+{
+    for (current = 0; current < phases.size(); current++)
+        if (phases[current].name == name)
+            break;
+    if (current == phases.size())
+        phases.push_back(PhaseStats(name));
+
+    phase_wall = wall_time();
+    phase_cpu  = cpu_time();
+    return phases[current];
+}
+
+PhaseStats &Stats::end()
+{
+    PhaseStats &ph = phases[current];
+    ph.wall    += wall_time() - phase_wall;
+    ph.cpu     += cpu_time()  - phase_cpu;
+    ph.rss      = current_rss();
+    ph.peak_rss = peak_rss();
+    return ph;
+}
+
+/*
+ * Phase names and counter names are fixed identifiers, so no string
+ * escaping is done.
+ */
+void Stats::write_json(std::ostream &out) const
+{
+    int nthreads = 1;
+    #ifdef _OPENMP
+        nthreads = omp_get_max_threads();
+    #endif
+
+    out << "{\n"
+        << "  \"program\": \"" << PACKAGE_NAME << "\",\n"
+        << "  \"version\": \"" << PACKAGE_VERSION << "\",\n"
+        << "  \"threads\": " << nthreads << ",\n"
+        << "  \"phases\": [";
+
+    for (std::size_t p = 0; p < phases.size(); p++) {
+        PhaseStats const &ph = phases[p];
+
+        out << (p ? "," : "") << "\n    {\n"
+            << "      \"name\": \"" << ph.name << "\",\n"
+            << "      \"wall_seconds\": " << ph.wall << ",\n"
+            << "      \"cpu_seconds\": " << ph.cpu << ",\n"
+            << "      \"rss_bytes\": " << ph.rss << ",\n"
+            << "      \"peak_rss_bytes\": " << ph.peak_rss;
+
+        if (ph.bytes) {
+            out << ",\n      \"bytes\": " << ph.bytes
+                << ",\n      \"mb_per_second\": "
+                << (ph.wall > 0 ? ph.bytes / ph.wall / 1e6 : 0.);
+        }
+        if (ph.work.flops)
+            out << ",\n      \"flops\": " << ph.work.flops;
+        if (ph.work.lookups)
+            out << ",\n      \"lookups\": " << ph.work.lookups;
+        if (!ph.work.thread_seconds.empty()) {
+            out << ",\n      \"thread_seconds\": [";
+            for (std::size_t t = 0; t < ph.work.thread_seconds.size(); t++)
+                out << (t ? ", " : "") << ph.work.thread_seconds[t];
+            out << "],\n      \"load_imbalance\": " << ph.work.imbalance();
+        }
+        for (std::size_t c = 0; c < ph.counters.size(); c++)
+            out << ",\n      \"" << ph.counters[c].first << "\": "
+                << ph.counters[c].second;
+
+        out << "\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
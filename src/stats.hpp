@@ -0,0 +1,92 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+double wall_time();
+
+/**
+ * Work done inside a parallel loop: flop count and busy time per thread.
+ * Filled in by Matrix::square, Matrix::output and Matrix::output_topk.
+ */
+struct WorkStats
+{
+    std::size_t flops;
+    std::size_t lookups;    // hash probes that didn't lead to a flop
+    std::vector<double> thread_seconds;
+
+    WorkStats() : flops(0), lookups(0) { }
+
+    // Record that the calling thread finished its share of the loop,
+    // which it started at wall_time() == start. Busy times add up over
+    // loops, per thread number.
+    void thread_done(double start);
+
+    // Ratio of slowest thread's busy time to the mean; 1 is perfect balance
+    double imbalance() const;
+};
+
+/**
+ * Resource usage and work counters for one phase of the computation.
+ */
+struct PhaseStats
+{
+    std::string name;
+    double wall, cpu;           // seconds
+    std::size_t bytes;          // input consumed; 0 if not applicable
+    std::size_t rss, peak_rss;  // bytes, at end of phase
+    WorkStats work;
+    std::vector<std::pair<std::string, std::size_t> > counters;
+
+    explicit PhaseStats(std::string const &n)
+      : name(n), wall(0), cpu(0), bytes(0), rss(0), peak_rss(0) { }
+
+    // Add n to the counter named what
+    void count(char const *what, std::size_t n);
+};
+
+/**
+ * Per-phase instrumentation of a wikiassoc run, written as JSON.
+ */
+class Stats
+{
+    std::vector<PhaseStats> phases;
+    std::size_t current;
+    double phase_wall, phase_cpu;
+
+  public:
+    Stats() : current(0), phase_wall(0), phase_cpu(0) { }
+
+    /**
+     * Start timing a new phase, or resume timing an earlier phase of the
+     * same name. Returns its record, which stays valid until the next
+     * call to begin.
+     */
+    PhaseStats &begin(char const *name);
+
+    /**
+     * Stop timing the current phase and record memory usage.
+     */
+    PhaseStats &end();
+
+    void write_json(std::ostream &) const;
+};
+
+std::size_t available_memory();
+std::size_t current_rss();
+std::size_t file_size(char const *path);
+
+#endif  // STATS_HPP
@@ -0,0 +1,355 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Exact top-k evaluation of pf-ibf rows with upper-bound pruning
+ * (MaxScore-style), without materializing the pf-ibf matrix.
+ *
+ * The unnormalized score of j for article i is
+ *
+ *     a(i,j) + sum_k a(i,k) b(k,j)
+ *
+ * and every term a(i,k) b(k,j) is at most a(i,k) * max_j b(k,j), the bound
+ * of intermediate article k. Intermediate articles are expanded in order
+ * of decreasing bound. Once the sum of the remaining bounds is below the
+ * k'th best score so far, no article that hasn't been seen can make it
+ * into the top k, and only the remaining candidates are updated, by
+ * lookup rather than by scanning rows; candidates whose upper bound drops
+ * below the k'th best score are discarded.
+ *
+ * Finally, the scores of the surviving candidates are recomputed with
+ * the same floating-point operations, in the same order, as Matrix::mult,
+ * Matrix::add and normalize<2>, including the rounding to W of their
+ * results, so output is identical to that of Matrix::output for any
+ * storage type W.
+ */
+
+#include <boost/unordered_map.hpp>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "wikiassoc.hpp"
+
+#include "article.hpp"
+#include "ibf.hpp"
+#include "matrix.hpp"
+#include "progress.hpp"
+
+namespace {
+    // Relative error allowed for the difference between the double
+    // precision bounds used for pruning and the final Real scores.
+    const double SLACK = 1e-3;
+
+    // Factor by which a bound must fall short of the threshold before a
+    // candidate is dropped, given that its final score is rounded to W
+    // three times (by mult, add and transform), as is the k'th best.
+    template <typename W>
+    double margin()
+    {
+        double e = weight_error<W>();
+        return (1 + SLACK) * std::pow((1 + e) / (1 - e), 3);
+    }
+
+    typedef std::pair<unsigned, Real> Entry;
+    typedef boost::unordered_map<unsigned, double> Candidates;
+
+    // Type in which BasicMatrix<W>::mult_row sums products
+    template <typename W> struct ProductSum { typedef double type; };
+    template <> struct ProductSum<Real> { typedef Real type; };
+
+    // Intermediate article k with a(i,k) and its bound
+    struct Term
+    {
+        unsigned k;
+        Real aik;
+        double bound;
+
+        Term(unsigned k_, Real a, double b) : k(k_), aik(a), bound(b) { }
+
+        bool operator<(Term const &other) const
+        { return bound > other.bound; }
+    };
+
+    // Same order as used by Matrix::output
+    inline bool GtBySecond(Entry const &x, Entry const &y)
+    {
+        return x.second > y.second
+            || (x.second == y.second && x.first < y.first);
+    }
+
+    // k'th largest lower bound among the candidates; 0 if fewer than k
+    double kth_score(Candidates const &cand, std::size_t k)
+    {
+        if (cand.size() < k)
+            return 0;
+
+        std::vector<double> scores;
+        scores.reserve(cand.size());
+        for (Candidates::const_iterator c = cand.begin(), end = cand.end();
+             c != end; ++c)
+            scores.push_back(c->second);
+        std::nth_element(scores.begin(), scores.begin() + k - 1,
+                         scores.end(), std::greater<double>());
+        return scores[k - 1];
+    }
+
+    inline bool below(double upper, double threshold, double margin)
+    {
+        return upper * margin < threshold;
+    }
+
+    // Drop candidates whose score can't reach threshold with at most
+    // remaining added to it
+    void discard_hopeless(Candidates &cand, double remaining,
+                          double threshold, double margin)
+    {
+        for (Candidates::iterator c = cand.begin(); c != cand.end(); )
+            if (below(c->second + remaining, threshold, margin))
+                c = cand.erase(c);
+            else
+                ++c;
+    }
+}
+
+/*
+ * Compute the top k of row i of the full pf-ibf matrix *this * b + *this,
+ * without its diagonal and columns j for which include[j] is false, into
+ * out. rowmax holds the largest element of each row of b.
+ */
+template <typename W>
+void BasicMatrix<W>::topk_row(BasicMatrix const &b, unsigned i, std::size_t k,
+                              std::vector<Real> const &rowmax,
+                              std::vector<char> const &include,
+                              std::vector<Entry> &out,
+                              std::size_t &flops, std::size_t &lookups) const
+{
+    out.clear();
+    if (k == 0)
+        return;
+
+    row_type const &ai = rows[i];
+    double const slack = margin<W>();
+
+    // Seed candidates with the direct links
+    Candidates cand;
+    for (typename row_type::const_iterator ij = ai.begin(), end = ai.end();
+         ij != end; ++ij)
+        if (ij->first != i && include[ij->first])
+            cand[ij->first] = ij->second;
+
+    std::vector<Term> terms;
+    for (typename row_type::const_iterator ik = ai.begin(), end = ai.end();
+         ik != end; ++ik)
+        if (!b.rows[ik->first].empty())
+            terms.push_back(Term(ik->first, ik->second,
+                                 double(ik->second) * rowmax[ik->first]));
+    std::sort(terms.begin(), terms.end());
+
+    // remaining[t] is the sum of bounds of terms t and up
+    std::vector<double> remaining(terms.size() + 1);
+    for (std::size_t t = terms.size(); t-- > 0; )
+        remaining[t] = remaining[t + 1] + terms[t].bound;
+
+    double threshold = 0;
+    std::size_t t = 0, since_check = 0;
+
+    // Expand intermediate articles while unseen articles may still
+    // make it into the top k. The threshold is recomputed once the work
+    // done since the last time is comparable to the cost of recomputing
+    // it.
+    for (; t < terms.size(); t++) {
+        if (2 * since_check >= cand.size()) {
+            threshold = kth_score(cand, k);
+            since_check = 0;
+        }
+        if (below(remaining[t], threshold, slack))
+            break;
+
+        row_type const &bk = b.rows[terms[t].k];
+        double aik = terms[t].aik;
+        for (typename row_type::const_iterator kj = bk.begin(), end = bk.end();
+             kj != end; ++kj)
+            if (kj->first != i && include[kj->first])
+                cand[kj->first] += aik * kj->second;
+        flops += 2 * bk.size();
+        since_check += bk.size();
+    }
+
+    // Only the candidates can make it now; update them with the
+    // remaining terms, discarding those that fall behind.
+    if (t < terms.size()) {
+        threshold = kth_score(cand, k);
+        discard_hopeless(cand, remaining[t], threshold, slack);
+        since_check = 0;
+
+        for (; t < terms.size(); t++) {
+            row_type const &bk = b.rows[terms[t].k];
+            double aik = terms[t].aik;
+
+            if (cand.size() < bk.size()) {
+                for (Candidates::iterator c = cand.begin(), end = cand.end();
+                     c != end; ++c) {
+                    typename row_type::const_iterator kj = bk.find(c->first);
+                    if (kj != bk.end()) {
+                        c->second += aik * kj->second;
+                        flops += 2;
+                    } else
+                        lookups++;
+                }
+                since_check += cand.size();
+            } else {
+                for (typename row_type::const_iterator kj = bk.begin(),
+                                                       end = bk.end();
+                     kj != end; ++kj) {
+                    Candidates::iterator c = cand.find(kj->first);
+                    if (c != cand.end()) {
+                        c->second += aik * kj->second;
+                        flops += 2;
+                    } else
+                        lookups++;
+                }
+                since_check += bk.size();
+            }
+
+            if (2 * since_check >= cand.size()) {
+                threshold = kth_score(cand, k);
+                discard_hopeless(cand, remaining[t + 1], threshold, slack);
+                since_check = 0;
+            }
+        }
+    }
+
+    // Recompute exact scores as Matrix::mult would, summing over the
+    // intermediate articles in row order: either by looking up each
+    // candidate in each row of b, or by scanning those rows, whichever
+    // is cheaper.
+    std::size_t scan_cost = 0;
+    for (typename row_type::const_iterator ik = ai.begin(), end = ai.end();
+         ik != end; ++ik)
+        scan_cost += b.rows[ik->first].size();
+
+    typedef typename ProductSum<W>::type Sum;
+    boost::unordered_map<unsigned, Sum> exact;
+    if (cand.size() * ai.size() < scan_cost) {
+        for (Candidates::const_iterator c = cand.begin(), end = cand.end();
+             c != end; ++c) {
+            Sum &score = exact[c->first];
+            for (typename row_type::const_iterator ik = ai.begin(),
+                                                   ai_end = ai.end();
+                 ik != ai_end; ++ik) {
+                row_type const &bk = b.rows[ik->first];
+                typename row_type::const_iterator kj = bk.find(c->first);
+                if (kj != bk.end())
+                    score += Sum(Real(ik->second)) * Real(kj->second);
+            }
+        }
+        lookups += cand.size() * ai.size();
+    } else {
+        for (Candidates::const_iterator c = cand.begin(), end = cand.end();
+             c != end; ++c)
+            exact[c->first] = 0;
+        for (typename row_type::const_iterator ik = ai.begin(),
+                                               ai_end = ai.end();
+             ik != ai_end; ++ik) {
+            row_type const &bk = b.rows[ik->first];
+            for (typename row_type::const_iterator kj = bk.begin(),
+                                                   end = bk.end();
+                 kj != end; ++kj) {
+                typename boost::unordered_map<unsigned, Sum>::iterator
+                    e = exact.find(kj->first);
+                if (e != exact.end())
+                    e->second += Sum(Real(ik->second)) * Real(kj->second);
+            }
+        }
+        lookups += scan_cost;
+    }
+
+    for (typename boost::unordered_map<unsigned, Sum>::const_iterator
+             e = exact.begin(), end = exact.end();
+         e != end; ++e) {
+        // Stored as W by mult, add and transform in turn
+        W score = Real(e->second);
+        typename row_type::const_iterator ij = ai.find(e->first);
+        if (ij != ai.end())
+            score = score + ij->second;
+        W x = normalize<2>(e->first, score);
+        out.push_back(Entry(e->first, x));
+    }
+
+    std::size_t n = std::min(k, out.size());
+    std::partial_sort(out.begin(), out.begin() + n, out.end(), GtBySecond);
+    out.resize(n);
+}
+
+/**
+ * Pass at most n_out term associations per article to emit, like
+ * Matrix::output on the full pf-ibf matrix *this * b + *this, but
+ * computing only as much of each row as is needed to find its top n_out.
+ *
+ * Work done is recorded in ws and can be compared to the flops needed
+ * for a full multiplication.
+ */
+template <typename W>
+void BasicMatrix<W>::output_topk(BasicMatrix const &b, std::size_t n_out,
+                                 ResultCallback const &emit,
+                                 boost::regex const &exclude,
+                                 ArticleSet const &articles,
+                                 WorkStats &ws) const
+{
+    int i, n = nrows();
+
+    // Match the exclusion RE once per article, not once per score
+    std::vector<char> include(n);
+    #pragma omp parallel for
+    for (i=0; i<n; i++)
+        include[i] = !boost::regex_match(articles[i].title, exclude);
+
+    std::vector<Real> rowmax(n);
+    #pragma omp parallel for
+    for (i=0; i<n; i++)
+        for (typename row_type::const_iterator kj = b.rows[i].begin(),
+                                               end = b.rows[i].end();
+             kj != end; ++kj)
+            rowmax[i] = std::max(rowmax[i], Real(kj->second));
+
+    std::size_t flops = 0, lookups = 0;
+
+    #pragma omp parallel reduction(+:flops,lookups)
+    {
+        double start = wall_time();
+        std::vector<Entry> related;
+
+        #pragma omp for schedule(dynamic, 64) nowait
+        for (i=0; i<n; i++) {
+            progress.rows.add();
+            if (!include[i])
+                continue;
+
+            topk_row(b, i, n_out, rowmax, include, related, flops, lookups);
+            emit(i, related);
+        }
+
+        ws.thread_done(start);
+    }
+
+    ws.flops += flops;
+    ws.lookups += lookups;
+}
+
+#define INSTANTIATE(W) \
+    template void BasicMatrix<W>::output_topk(BasicMatrix const &, \
+                                              std::size_t, \
+                                              ResultCallback const &, \
+                                              boost::regex const &, \
+                                              ArticleSet const &, \
+                                              WorkStats &) const;
+FOR_EACH_WEIGHT(INSTANTIATE)
+#undef INSTANTIATE
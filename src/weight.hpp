@@ -0,0 +1,141 @@
+/*
+ * Copyright 2010-2011 Lars Buitinck
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef WEIGHT_HPP
+#define WEIGHT_HPP
+
+#include <boost/cstdint.hpp>
+#include <boost/integer.hpp>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "wikiassoc.hpp"
+
+/*
+ * Storage types for matrix elements, besides float and double.
+ *
+ * Each converts implicitly from and to Real, so that matrix code can read
+ * and write them as if they were Real; sums of products are formed in Real
+ * or wider and rounded only when stored.
+ */
+
+/**
+ * bfloat16: the upper half of an IEEE single, i.e. a float with an 8-bit
+ * mantissa. Rounds to nearest even.
+ */
+class BFloat16 {
+    boost::uint16_t bits;
+
+  public:
+    BFloat16(Real x = 0)
+    {
+        boost::uint32_t u;
+        std::memcpy(&u, &x, sizeof(u));
+        u += 0x7FFF + ((u >> 16) & 1);
+        bits = u >> 16;
+    }
+
+    operator Real() const
+    {
+        boost::uint32_t u = boost::uint32_t(bits) << 16;
+        Real x;
+        std::memcpy(&x, &u, sizeof(x));
+        return x;
+    }
+};
+
+/**
+ * Non-negative weight quantized to a Bits-bit code on a logarithmic
+ * scale from 2^MIN_EXP to 2^MAX_EXP, which covers ibf values and pf-ibf
+ * scores; code 0 is reserved for 0. Relative error is about 0.02% for
+ * 16 bits and 4.5% for 8 bits. Decoding is a table lookup.
+ */
+template <unsigned Bits>
+class LogWeight {
+    typedef typename boost::uint_t<Bits>::least code_type;
+
+    static const unsigned MAX_CODE = (1u << Bits) - 1;
+    static const int MIN_EXP = -8, MAX_EXP = 24;
+
+    static std::vector<Real> const decoding;
+
+    static std::vector<Real> make_decoding()
+    {
+        double step = double(MAX_EXP - MIN_EXP) / (MAX_CODE - 1);
+        std::vector<Real> table(MAX_CODE + 1);
+        for (unsigned c = 1; c <= MAX_CODE; c++)
+            table[c] = std::pow(2., MIN_EXP + (c - 1) * step);
+        return table;
+    }
+
+    code_type code;
+
+  public:
+    LogWeight(Real x = 0)
+    {
+        if (!(x > 0)) {
+            code = 0;
+            return;
+        }
+        double c = 1 + (std::log(double(x)) / std::log(2.) - MIN_EXP)
+                     * (MAX_CODE - 1) / (MAX_EXP - MIN_EXP);
+        code = c < 1 ? 1
+             : c > MAX_CODE ? MAX_CODE
+             : code_type(c + .5);
+    }
+
+    operator Real() const { return decoding[code]; }
+
+    // Bound on the relative error of rounding to the nearest code
+    static double max_error()
+    {
+        return std::pow(2., .5 * (MAX_EXP - MIN_EXP) / (MAX_CODE - 1)) - 1;
+    }
+};
+
+template <unsigned Bits>
+std::vector<Real> const LogWeight<Bits>::decoding
+    = LogWeight<Bits>::make_decoding();
+
+/**
+ * Name of storage type W, as accepted by the -P option.
+ */
+template <typename W> char const *weight_name();
+
+template <> inline char const *weight_name<float>()    { return "float"; }
+template <> inline char const *weight_name<double>()   { return "double"; }
+template <> inline char const *weight_name<BFloat16>() { return "bf16"; }
+template <> inline char const *weight_name<LogWeight<16> >()
+{ return "log16"; }
+template <> inline char const *weight_name<LogWeight<8> >()
+{ return "log8"; }
+
+/**
+ * Bound on the relative error of storing a Real as W.
+ */
+template <typename W> double weight_error();
+
+template <> inline double weight_error<float>()    { return 0; }
+template <> inline double weight_error<double>()   { return 0; }
+template <> inline double weight_error<BFloat16>() { return 1. / 256; }
+template <> inline double weight_error<LogWeight<16> >()
+{ return LogWeight<16>::max_error(); }
+template <> inline double weight_error<LogWeight<8> >()
+{ return LogWeight<8>::max_error(); }
+
+/*
+ * Apply macro M to each storage type that matrix code is compiled for;
+ * used for explicit instantiation. FOR_EACH_OTHER_WEIGHT skips Real.
+ */
+#define FOR_EACH_OTHER_WEIGHT(M) \
+    M(double) M(BFloat16) M(LogWeight<16>) M(LogWeight<8>)
+#define FOR_EACH_WEIGHT(M) M(float) FOR_EACH_OTHER_WEIGHT(M)
+
+#endif  // WEIGHT_HPP
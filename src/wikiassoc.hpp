@@ -10,8 +10,11 @@
 #ifndef WIKITHES_HPP
 #define WIKITHES_HPP
 
+#include <cstddef>
+#include <functional>
 #include <iosfwd>
 #include <string>
+#include <utility>
 #include <vector>
 
 
@@ -19,24 +22,40 @@
 const int WIKIPEDIA_MAIN_NS = 0;
 
 
-class ArticleSet;
-class Matrix;
-
 // Type for weight calculations. Redefine as double or bigger if needed;
-// float suffices for 6e5 articles.
+// float suffices for 6e5 articles. Matrix elements may be stored in
+// other types; see weight.hpp.
 // TODO: put this in config.h
 typedef float Real;
 
 
+// Receiver of the associations of an article, best first, as (article,
+// score) pairs. Called from several threads at once.
+typedef std::function<void (unsigned,
+                            std::vector<std::pair<unsigned, Real> > const &)>
+    ResultCallback;
+
+
+class ArticleSet;
+template <typename W> class BasicMatrix;
+typedef BasicMatrix<Real> Matrix;
+class RedirectSet;
+
+
 extern bool quiet;      // disable log output to stderr
 
 
 void logmsg(char const *);
 void logmsg(std::string const &);
 std::istream *open_input(char const *);
-void parse_linktable(std::istream &, ArticleSet &, Matrix &,
-                     std::vector<unsigned> &);
-void parse_pagetable(std::istream &, ArticleSet &);
+void parse_linktable(std::istream &, ArticleSet &, RedirectSet const &,
+                     Matrix &, std::vector<unsigned> &);
+void parse_pagetable(std::istream &, ArticleSet &, RedirectSet *);
+void parse_redirecttable(std::istream &, ArticleSet const &, RedirectSet &);
+template <typename W, typename V>
+double sample_recall(BasicMatrix<W> const &, BasicMatrix<W> const &,
+                     BasicMatrix<V> const &, BasicMatrix<V> const &,
+                     std::size_t, unsigned);
 void sql_unescape(std::string &);
 
 #endif  // WIKITHES_HPP